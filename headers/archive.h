@@ -0,0 +1,109 @@
+#pragma once
+
+#include "layout.h"
+#include "hash.h"
+
+/**
+ * Deduplicating archive of many save versions, one directory:
+ *
+ * pack.bin      unique objects appended back to back, never rewritten
+ * pack.idx      [ArchiveObject] * n, where every object of the pack lives
+ * versions.csv  one row per ingested version
+ * <n>.recipe    [ArchiveRecipeHeader] [ArchiveObject] * object_count
+ *
+ * A save is split as `SaveLayout` describes it: head (up to and
+ * including the `RawDatabaseImage` property header), every `UpkOodle`
+ * block of the stream (raw `OODLE_MAX_BLOCK_SIZE` slices of decompressed
+ * saves) and tail. Objects are keyed by two xxHash64 of the content,
+ * a key hit is compared byte for byte with the pack, and an object
+ * already in the pack is only referenced by the recipe.
+ *
+ * Restoring maps the pack and writes recipe objects straight out of
+ * the view, objects adjacent in the pack are written with a single call.
+ */
+#define ARCHIVE_PACK_FILENAME "pack.bin"
+#define ARCHIVE_INDEX_FILENAME "pack.idx"
+#define ARCHIVE_VERSIONS_FILENAME "versions.csv"
+#define ARCHIVE_RECIPE_EXTENSION ".recipe"
+#define ARCHIVE_PATH_SEPARATOR "\\"
+
+#define ARCHIVE_RECIPE_SIGNATURE 0x52414C48
+#define ARCHIVE_RECIPE_VERSION 1
+
+// Seeds of both halves of the object key
+#define ARCHIVE_KEY_SEED_LOW 0
+#define ARCHIVE_KEY_SEED_HIGH XXH_PRIME64_5
+
+// Pack bytes read back at once to compare an object against its key hit
+#define ARCHIVE_COMPARE_SIZE 0x10000
+
+// Largest single WriteFile() while restoring
+#define ARCHIVE_WRITE_SIZE 0x40000000
+
+#pragma pack(push, 1)
+typedef struct _ARCHIVE_OBJECT {
+  uint64_t key[2];
+  uint64_t offset;
+  uint64_t size;
+} ArchiveObject;
+
+typedef struct _ARCHIVE_RECIPE_HEADER {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t object_count;
+  uint64_t file_size;
+} ArchiveRecipeHeader;
+#pragma pack(pop)
+
+/**
+ * Open addressing table of every object in the pack, keyed by `key[0]`,
+ * capacity is a power of two kept at least twice the count
+ */
+#define ARCHIVE_TABLE_CAPACITY 1024
+
+typedef struct _ARCHIVE_TABLE {
+  ArchiveObject *slots;
+  size_t capacity;
+  size_t count;
+} ArchiveTable;
+
+/**
+ * Archive opened for ingest, every file is appended to
+ */
+typedef struct _ARCHIVE_STORE {
+  const char *directory;
+  FILE *pack;
+  FILE *index;
+  FILE *versions;
+  uint64_t pack_size;
+  uint32_t version_count;
+  ArchiveTable table;
+} ArchiveStore;
+
+/**
+ * Single range of a save being ingested, hashed by its own pool task
+ */
+typedef struct _ARCHIVE_CHUNK {
+  const byte *address;
+  size_t size;
+  uint64_t key[2];
+  PoolTask *task;
+} ArchiveChunk;
+
+/**
+ * Save being ingested, read and split by a pool task
+ * into its own arena, committed to the pack in input order
+ */
+typedef struct _ARCHIVE_JOB {
+  const char *filename;
+  Arena *arena;
+  size_t file_size;
+  ArchiveChunk *chunks;
+  size_t chunk_count;
+  bool compressed;
+  bool failed;
+} ArchiveJob;
+
+// public
+int archive(const char *directory, int count, const char *filenames[], bool verbose);
+int restore(const char *directory, const char *version, const char *output_filename, bool verbose);
@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * Per-job arena allocator
+ *
+ * Small allocations are bumped out of pooled blocks, large ones
+ * (at least `ARENA_LARGE_SIZE`) get their own VirtualAlloc() mapping,
+ * optionally backed by large pages. Nothing is freed individually,
+ * the whole job goes away with a single `arena_release()`.
+ */
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_LARGE_SIZE 1048576
+#define ARENA_ALIGNMENT 16
+
+typedef enum _ARENA_KIND {
+  ARENA_UNINITIALIZED = 0,
+  ARENA_ZEROED = 1
+} ArenaKind;
+
+typedef struct _ARENA_BLOCK {
+  struct _ARENA_BLOCK *next;
+  size_t size;
+  size_t used;
+} ArenaBlock;
+
+// Block header rounded up, allocations after it keep `ARENA_ALIGNMENT`
+#define ARENA_HEADER_SIZE ((sizeof (ArenaBlock) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+typedef struct _ARENA {
+  ArenaBlock *blocks;
+  ArenaBlock *large;
+  bool huge_pages;
+  size_t large_page_size;
+  size_t allocated;
+} Arena;
+
+// public
+Arena *arena_create(bool huge_pages);
+void *arena_alloc(Arena *arena, size_t size, ArenaKind kind);
+void arena_release(Arena *arena);
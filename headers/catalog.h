@@ -0,0 +1,13 @@
+#pragma once
+
+#include "layout.h"
+
+/**
+ * Metadata catalog of many save files:
+ * GVAS header and top level scalar properties are parsed
+ * from partial reads, `RawDatabaseImage` payload is skipped
+ * by its declared length and never read.
+ *
+ * One CSV row per save file is written to the index file.
+ */
+int catalog(const char *index_filename, int count, const char *filenames[], bool verbose);
@@ -9,6 +9,7 @@
 #include "string.h"
 #include "errno.h"
 #include "inttypes.h"
+#include "io.h"
 
 #ifndef NOMINMAX
   #define NOMINMAX
@@ -17,3 +18,4 @@
 #include <windows.h>
 
 #include "defines.h"
+#include "arena.h"
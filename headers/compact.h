@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * SQLite freelist compaction, a lightweight VACUUM:
+ *  - walk every b-tree from `sqlite_schema` and the freelist,
+ *    so every page is accounted for
+ *  - move pages in use past the new end of file into free slots,
+ *    rewriting child, overflow and root page numbers pointing at them
+ *  - drop the freelist and truncate the image
+ *
+ * Cell content is never rewritten, so unlike VACUUM nothing but page
+ * numbers changes. Databases the pass can not handle safely
+ * (auto-vacuum pointer maps, untrusted header, pages it can not account for)
+ * are left untouched.
+ */
+#define SQLITE_HEADER_SIZE 100
+#define SQLITE_LOCK_BYTE_OFFSET 0x40000000
+
+// SQLite header field offsets (big endian)
+#define SQLITE_HEADER_PAGE_SIZE 16
+#define SQLITE_HEADER_RESERVED 20
+#define SQLITE_HEADER_CHANGE_COUNTER 24
+#define SQLITE_HEADER_DATABASE_SIZE 28
+#define SQLITE_HEADER_FREELIST_TRUNK 32
+#define SQLITE_HEADER_FREELIST_COUNT 36
+#define SQLITE_HEADER_SCHEMA_COOKIE 40
+#define SQLITE_HEADER_LARGEST_ROOT 52
+#define SQLITE_HEADER_VERSION_VALID_FOR 92
+
+// B-tree page types
+#define SQLITE_PAGE_INTERIOR_INDEX 0x02
+#define SQLITE_PAGE_INTERIOR_TABLE 0x05
+#define SQLITE_PAGE_LEAF_INDEX 0x0A
+#define SQLITE_PAGE_LEAF_TABLE 0x0D
+
+// Column of `sqlite_schema` holding the root page number
+#define SQLITE_SCHEMA_ROOTPAGE_COLUMN 3
+
+typedef enum _PAGE_KIND {
+  PAGE_UNKNOWN = 0,
+  PAGE_BTREE,
+  PAGE_OVERFLOW,
+  PAGE_FREE
+} PageKind;
+
+/**
+ * Pages are classified first (`mapping` is NULL),
+ * the same walk then rewrites page numbers through `mapping`
+ */
+typedef struct _COMPACT_CONTEXT {
+  byte *image;
+  uint32_t page_size;
+  uint32_t usable_size;
+  uint32_t page_count;
+  uint8_t *kinds;
+  uint32_t *mapping;
+} CompactContext;
+
+// public
+size_t compact(byte *image, size_t size, Arena *arena, bool verbose);
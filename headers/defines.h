@@ -63,7 +63,16 @@ typedef struct _UProperty_Array {
 // Supported commands
 #define COMMAND_DECOMPRESS "-d"
 #define COMMAND_COMPRESS "-c"
+#define COMMAND_EDIT "-e"
+#define COMMAND_CATALOG "-l"
+#define COMMAND_VERIFY "-t"
+#define COMMAND_ARCHIVE "-a"
+#define COMMAND_RESTORE "-r"
 #define VERBOSITY_FLAG "-v"
+#define HUGE_PAGES_FLAG "--huge-pages"
+#define JOBIFY_FLAG "--jobify="
+#define COMPACT_FLAG "--compact"
+#define MANIFEST_FLAG "--manifest"
 
 // Sick of duplicated string literals
 #define APPLICATION_IMAGE_NAME "hlsaves.exe"
@@ -82,9 +91,6 @@ typedef struct _UProperty_Array {
 // UArrayProperty size is data + 4
 #define UARRAYPROPERTY_ADDED_LENGTH 4
 
-// Multiplication factor for UArrayProperty size
-#define OODLE_COMPRESSION_FACTOR_MAGIC 15
-
 // Oodle UPK signature
 #define OODLE_MAX_BLOCK_SIZE 131072
 #define OODLE_COMPRESSED_BLOCK_SIGNATURE 0x9E2A83C1
@@ -125,6 +131,13 @@ do { \
     memset(pointer, 0, size); \
 } while (0)
 
+/**
+ * Allocate from the job arena, `kind` tells whether memory has to be zeroed
+ */
+#define ARENA_ALLOC(arena, type, pointer) ARENA_ALLOC_SIZE(arena, type, pointer, sizeof (type), ARENA_ZEROED)
+#define ARENA_ALLOC_SIZE(arena, type, pointer, size, kind) \
+type *pointer = (type *) arena_alloc(arena, size, kind)
+
 /**
  * Open a file or error out on failure
  */
@@ -172,11 +185,11 @@ do { \
  * Read block of data into FString
  * TODO: Handle ASCI/UCS2 serialization
  */
-#define READ_FSTRING(string, memory) do { \
+#define READ_FSTRING(arena, string, memory) do { \
   COPY_MEMORY(memory, &string.length, sizeof (string.length)); \
   if (string.length > 0) { \
     size_t data_size = sizeof (byte) * string.length; \
-    SAFE_ALLOC_SIZE(byte, data, data_size); \
+    ARENA_ALLOC_SIZE(arena, byte, data, data_size, ARENA_UNINITIALIZED); \
     COPY_MEMORY(memory, data, data_size); \
     string.data = data; \
   } \
@@ -218,6 +231,12 @@ do { \
  */
 void *memmem(const void *haystack, size_t haystack_len, const void *needle, const size_t needle_len);
 
+/**
+ * Windows does not support pread() either, read from an absolute offset
+ * returns number of bytes read or -1 on failure
+ */
+int64_t pread(HANDLE file, void *buffer, size_t count, uint64_t offset);
+
 /**
  * Printf wrappers
  */
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "oodle.h"
+
+/**
+ * In-process edit pipeline:
+ *  - decompress `RawDatabaseImage` into memory
+ *  - load it with `sqlite3_deserialize()`
+ *  - run the SQL script against it
+ *  - serialize the database back and compress it,
+ *    reusing compressed blocks that did not change
+ *
+ * Nothing is written to disk besides the output save file.
+ */
+void edit(UProperty *property, const char *script_filename, OodleLZ_Jobify jobify, uint32_t compress_flags, Arena *arena, bool verbose);
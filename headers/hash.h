@@ -0,0 +1,14 @@
+#pragma once
+
+/**
+ * xxHash64, non-cryptographic hash running at memory bandwidth,
+ * used to fingerprint compressed blocks
+ */
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ull
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define XXH_PRIME64_3 0x165667B19E3779F9ull
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ull
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ull
+
+// public
+uint64_t xxh64(const void *input, size_t length, uint64_t seed);
@@ -0,0 +1,30 @@
+#pragma once
+
+/**
+ * Kraken blocks of a single byte repeated, which Oodle encodes
+ * as a block header and one memset quantum:
+ *
+ * [8C 06] compressed block header
+ * [07 FF FF xx] memset quantum filled with byte xx
+ *
+ * Such blocks are written and expanded without `oo2core_9_win64.dll`,
+ * everything else goes through Oodle.
+ */
+#define KRAKEN_QUANTUM_SIZE 0x40000
+
+// Block header, memset quantum header `07 FF FF` and the fill byte
+#define KRAKEN_MEMSET_FORM_SIZE 6
+
+/**
+ * Kernels used to expand memset blocks and to spot single byte runs,
+ * picked once by `kraken_init()` depending on the CPU: AVX2, SSE2 or scalar
+ */
+typedef void KrakenFill_FP (byte *destination, byte value, size_t size);
+typedef bool KrakenRepeats_FP (const byte *source, byte value, size_t size);
+
+// public
+const char *kraken_init();
+void kraken_fill(byte *destination, byte value, size_t size);
+bool kraken_repeat_scan(const byte *source, size_t size, byte *value);
+size_t kraken_encode_memset(byte value, byte *destination);
+bool kraken_memset_form(const byte *source, size_t source_size, size_t destination_size, byte *value);
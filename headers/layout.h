@@ -0,0 +1,30 @@
+#pragma once
+
+#include "oodle.h"
+
+/**
+ * Save split the way the tool reads it: head (everything before
+ * `RawDatabaseImage`), the property value (stream) and tail.
+ *
+ * Compressed streams are split into `UpkOodle` blocks (header + payload),
+ * decompressed ones into `OODLE_MAX_BLOCK_SIZE` slices of the SQLite image.
+ */
+typedef struct _SAVE_LAYOUT {
+  MemoryAddress head;
+  MemoryAddress stream;
+  MemoryAddress tail;
+  uint64_t file_size;
+} SaveLayout;
+
+typedef struct _STREAM_BLOCK {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t uncompressed_size;
+} StreamBlock;
+
+// public
+byte *read_file(const char *filename, size_t *size, Arena *arena);
+void csv_string(FILE *fp, const char *value);
+bool locate_layout(byte *buffer, size_t size, SaveLayout *layout);
+bool stream_compressed(const MemoryAddress *stream);
+size_t split_stream(const MemoryAddress *stream, bool compressed, StreamBlock *blocks);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "layout.h"
+#include "hash.h"
+
+/**
+ * Integrity manifest written next to a save as `<save>.manifest`:
+ *
+ * [ManifestHeader]
+ * [ManifestBlock] * block_count
+ *
+ * Head and tail are hashed whole, every block of the stream
+ * (see `SaveLayout`) is listed with its own hash.
+ *
+ * Verifying hashes the same ranges of the save, nothing is decompressed.
+ * Saves are verified in parallel, each on its own pool task.
+ */
+#define MANIFEST_SIGNATURE 0x464D4C48
+#define MANIFEST_VERSION 1
+#define MANIFEST_EXTENSION ".manifest"
+#define MANIFEST_HASH_SEED 0
+
+#pragma pack(push, 1)
+typedef struct _MANIFEST_HEADER {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t compressed;
+  uint32_t block_count;
+  uint64_t file_size;
+  uint64_t head_size;
+  uint64_t head_hash;
+  uint64_t stream_size;
+  uint64_t tail_size;
+  uint64_t tail_hash;
+} ManifestHeader;
+
+typedef struct _MANIFEST_BLOCK {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t uncompressed_size;
+  uint64_t hash;
+} ManifestBlock;
+#pragma pack(pop)
+
+// public
+int write_manifest(const char *save_filename, const SaveLayout *layout, Arena *arena, bool verbose);
+int verify(int count, const char *filenames[], bool verbose);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "pool.h"
+#include "kraken.h"
+#include "compact.h"
+
 #pragma pack(push, 1)
 /**
  * Structure is as follows:
@@ -86,7 +90,10 @@ typedef enum OodleLZ_Verbosity {
 } OodleLZ_Verbosity;
 
 typedef enum OodleLZ_Decode_ThreadPhase {
-  OodleLZ_Decode_ThreadPhaseAll = 3
+  OodleLZ_Decode_ThreadPhase1 = 1,
+  OodleLZ_Decode_ThreadPhase2 = 2,
+  OodleLZ_Decode_ThreadPhaseAll = 3,
+  OodleLZ_Decode_Unthreaded = OodleLZ_Decode_ThreadPhaseAll
 } OodleLZ_Decode_ThreadPhase;
 
 typedef enum OodleLZ_Profile {
@@ -145,6 +152,47 @@ typedef int WINAPI OodleLZ_Decompress_FP (
   void *scratch, size_t scratch_size, int threadPhase
 );
 
+typedef intptr_t OodleLZDecoder_MemorySizeNeeded_FP (
+  OodleLZ_Compressor compressor, intptr_t rawSize
+);
+
+typedef intptr_t OodleLZ_ThreadPhased_BlockDecoderMemorySizeNeeded_FP (void);
+
+/**
+ * Oodle job system plugin prototypes,
+ * a job never has more than `OODLE_JOB_MAX_DEPENDENCIES` dependencies
+ */
+#define OODLE_JOB_MAX_DEPENDENCIES 4
+
+typedef void WINAPI Oodle_Job_FP (void *job_data);
+
+typedef uint64_t WINAPI OodleCore_Plugin_RunJob_FP (
+  Oodle_Job_FP *fp_job, void *job_data, uint64_t *dependencies, int num_dependencies, void *user_ptr
+);
+
+typedef void WINAPI OodleCore_Plugin_WaitJob_FP (
+  uint64_t job_handle, void *user_ptr
+);
+
+typedef void WINAPI OodleCore_Plugins_SetJobSystemAndCount_FP (
+  OodleCore_Plugin_RunJob_FP *fp_RunJob, OodleCore_Plugin_WaitJob_FP *fp_WaitJob, int target_parallelism
+);
+
+/**
+ * Compress flags taken from the command line
+ */
+#define COMPRESS_COMPACT 0x1
+
+/**
+ * Previously compressed stream and the SQLite image it decompressed to,
+ * compressed blocks whose raw bytes did not change are copied verbatim
+ * instead of being compressed again
+ */
+typedef struct _UPK_REUSE {
+  MemoryAddress compressed;
+  MemoryAddress sqlite;
+} UpkReuse;
+
 // public
-void compress(UProperty *property, bool verbose);
-void decompress(UProperty *property, bool verbose);
+void compress(UProperty *property, const UpkReuse *reuse, OodleLZ_Jobify jobify, uint32_t flags, Arena *arena, bool verbose);
+void decompress(UProperty *property, Arena *arena, bool verbose);
@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+ * Process wide work-stealing pool shared by every command,
+ * so concurrent work never spawns more threads than cores.
+ *
+ * Every worker owns a deque, tasks submitted from a worker go to its
+ * own deque (newest first), tasks from other threads go to a shared
+ * injection queue and idle workers steal the oldest tasks of others.
+ *
+ * `pool_wait()` executes queued tasks itself while waiting,
+ * so waiting from inside a task can not deadlock the pool.
+ * `pool_wait_group()` only helps with tasks of the same group,
+ * so a task waiting on its own sub-tasks never runs unrelated
+ * work on its stack.
+ *
+ * Tasks submitted with dependencies are queued by whichever thread
+ * finishes the last dependency, nobody blocks waiting for them.
+ */
+typedef void PoolTask_FP (void *argument);
+
+typedef struct _POOL_LINK {
+  struct _POOL_TASK *task;
+  struct _POOL_LINK *next;
+} PoolLink;
+
+typedef struct _POOL_TASK {
+  PoolTask_FP *function;
+  void *argument;
+  const void *group;
+  volatile LONG done;
+  volatile LONG references;
+  volatile LONG blockers;
+  PoolLink *dependents;
+  struct _POOL_TASK *prev;
+  struct _POOL_TASK *next;
+} PoolTask;
+
+// public
+void pool_init(uint32_t threads);
+void pool_release();
+uint32_t pool_size();
+PoolTask *pool_submit(PoolTask_FP *function, void *argument);
+PoolTask *pool_submit_after(PoolTask_FP *function, void *argument, const void *group, PoolTask **dependencies, int count);
+void pool_wait(PoolTask *task);
+void pool_wait_group(PoolTask *task, const void *group);
@@ -0,0 +1,554 @@
+#include "archive.h"
+
+/**
+ * Join archive directory and a file name
+ */
+static char *archive_path(const char *directory, const char *name, Arena *arena) {
+  size_t length = strlen(directory) + sizeof (ARCHIVE_PATH_SEPARATOR) + strlen(name);
+  ARENA_ALLOC_SIZE(arena, char, path, length, ARENA_UNINITIALIZED);
+  snprintf(path, length, "%s" ARCHIVE_PATH_SEPARATOR "%s", directory, name);
+
+  return path;
+}
+
+static char *recipe_path(const char *directory, uint32_t version, Arena *arena) {
+  char name[32];
+  snprintf(name, sizeof (name), "%u" ARCHIVE_RECIPE_EXTENSION, version);
+
+  return archive_path(directory, name, arena);
+}
+
+/**
+ * Slot holding the object or the empty slot it would go to
+ */
+static ArchiveObject *table_find(const ArchiveTable *table, const uint64_t key[2], uint64_t size) {
+  size_t mask = table->capacity - 1;
+  for (size_t i = key[0] & mask; ; i = (i + 1) & mask) {
+    ArchiveObject *slot = &table->slots[i];
+    if (slot->size == 0 || (slot->key[0] == key[0] && slot->key[1] == key[1] && slot->size == size)) {
+      return slot;
+    }
+  }
+}
+
+static void table_insert(ArchiveTable *table, const ArchiveObject *object) {
+  if ((table->count + 1) * 2 > table->capacity) {
+    ArchiveObject *slots = table->slots;
+    size_t capacity = table->capacity;
+
+    table->capacity = capacity * 2;
+    SAFE_ALLOC_SIZE(ArchiveObject, grown, sizeof (ArchiveObject) * table->capacity);
+    table->slots = grown;
+    for (size_t i = 0; i < capacity; i++) {
+      if (slots[i].size != 0) {
+        *table_find(table, slots[i].key, slots[i].size) = slots[i];
+      }
+    }
+    free(slots);
+  }
+
+  ArchiveObject *slot = table_find(table, object->key, object->size);
+  if (slot->size == 0) {
+    *slot = *object;
+    table->count++;
+  }
+}
+
+static void key_task(void *argument) {
+  ArchiveChunk *chunk = (ArchiveChunk *) argument;
+  chunk->key[0] = xxh64(chunk->address, chunk->size, ARCHIVE_KEY_SEED_LOW);
+  chunk->key[1] = xxh64(chunk->address, chunk->size, ARCHIVE_KEY_SEED_HIGH);
+}
+
+/**
+ * Read the save, split it into head, stream blocks and tail, key every chunk
+ */
+static void ingest_task(void *argument) {
+  ArchiveJob *job = (ArchiveJob *) argument;
+
+  byte *buffer = read_file(job->filename, &job->file_size, job->arena);
+  if (buffer == NULL) {
+    job->failed = true;
+    return;
+  }
+
+  SaveLayout layout;
+  if (!locate_layout(buffer, job->file_size, &layout)) {
+    printf_error("%s: could not locate \"RawDatabaseImage\" UProperty", job->filename);
+    job->failed = true;
+    return;
+  }
+
+  job->compressed = stream_compressed(&layout.stream);
+  size_t block_count = split_stream(&layout.stream, job->compressed, NULL);
+  if (block_count == 0) {
+    printf_error("%s: can not split %llu bytes of RawDatabaseImage into blocks", job->filename, layout.stream.size);
+    job->failed = true;
+    return;
+  }
+
+  ARENA_ALLOC_SIZE(job->arena, StreamBlock, blocks, sizeof (StreamBlock) * block_count, ARENA_ZEROED);
+  split_stream(&layout.stream, job->compressed, blocks);
+
+  /**
+   * Head keeps the property header, so blocks are the stream alone
+   */
+  ARENA_ALLOC_SIZE(job->arena, ArchiveChunk, chunks, sizeof (ArchiveChunk) * (block_count + 2), ARENA_ZEROED);
+  chunks[0].address = buffer;
+  chunks[0].size = layout.stream.address - buffer;
+  for (size_t i = 0; i < block_count; i++) {
+    chunks[i + 1].address = layout.stream.address + blocks[i].offset;
+    chunks[i + 1].size = blocks[i].size;
+  }
+  job->chunk_count = block_count + 1;
+
+  if (layout.tail.size > 0) {
+    chunks[job->chunk_count].address = layout.tail.address;
+    chunks[job->chunk_count].size = layout.tail.size;
+    job->chunk_count++;
+  }
+  job->chunks = chunks;
+
+  for (size_t i = 0; i < job->chunk_count; i++) {
+    chunks[i].task = pool_submit_after(key_task, &chunks[i], job, NULL, 0);
+  }
+
+  for (size_t i = 0; i < job->chunk_count; i++) {
+    pool_wait_group(chunks[i].task, job);
+  }
+}
+
+/**
+ * Flush the stream and commit it to disk, whatever refers to the file
+ * must not reach the disk before it
+ */
+static int commit_file(FILE *fp, const char *name) {
+  if (fflush(fp) != 0 || _commit(_fileno(fp)) != 0) {
+    printf_error("Committing archive %s failed with error(%d): %s", name, errno, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Whether the object in the pack holds exactly the chunk,
+ * keys only select the candidate and never stand in for the content
+ */
+static bool pack_matches(ArchiveStore *store, const ArchiveObject *object, const ArchiveChunk *chunk, byte *buffer) {
+  if (_fseeki64(store->pack, (int64_t) object->offset, SEEK_SET) != 0) {
+    return false;
+  }
+
+  bool matches = true;
+  for (size_t offset = 0; matches && offset < chunk->size; offset += ARCHIVE_COMPARE_SIZE) {
+    size_t size = chunk->size - offset < ARCHIVE_COMPARE_SIZE ? chunk->size - offset : ARCHIVE_COMPARE_SIZE;
+    matches = fread(buffer, 1, size, store->pack) == size && memcmp(buffer, chunk->address + offset, size) == 0;
+  }
+
+  return matches;
+}
+
+/**
+ * Append new objects to the pack, then to the index, then write the recipe
+ * and the versions row, every file is committed to disk before the next one
+ * refers to it, so an interrupted ingest never leaves an index entry or a
+ * recipe pointing past the pack
+ */
+static int commit_version(ArchiveStore *store, ArchiveJob *job, bool verbose) {
+  ARENA_ALLOC_SIZE(job->arena, ArchiveObject, objects, sizeof (ArchiveObject) * job->chunk_count, ARENA_ZEROED);
+  ARENA_ALLOC_SIZE(job->arena, ArchiveObject, added, sizeof (ArchiveObject) * job->chunk_count, ARENA_ZEROED);
+  ARENA_ALLOC_SIZE(job->arena, byte, buffer, ARCHIVE_COMPARE_SIZE, ARENA_UNINITIALIZED);
+
+  size_t added_count = 0;
+  uint64_t added_size = 0;
+  for (size_t i = 0; i < job->chunk_count; i++) {
+    ArchiveChunk *chunk = &job->chunks[i];
+    ArchiveObject *slot = table_find(&store->table, chunk->key, chunk->size);
+    if (slot->size != 0) {
+      /**
+       * Pack is read back through the same append stream,
+       * pending writes go out first and appending resumes at the end
+       */
+      if (fflush(store->pack) != 0) {
+        printf_error("Flushing archive pack failed with error(%d): %s", errno, strerror(errno));
+        return EXIT_FAILURE;
+      }
+      bool matches = pack_matches(store, slot, chunk, buffer);
+      _fseeki64(store->pack, 0, SEEK_END);
+
+      if (matches) {
+        objects[i] = *slot;
+        continue;
+      }
+
+      /**
+       * Key collision, the chunk is stored as an object of its own,
+       * the table keeps pointing at the first one
+       */
+      printf_verbose(verbose, "%s: object #%llu collides with the %llu bytes object at pack offset %llu, storing it apart",
+        job->filename, i, slot->size, slot->offset
+      );
+    }
+
+    WRITE_FILE_WITH_ERROR_HANDLE(store->pack, chunk->address, chunk->size, 1);
+    objects[i].key[0] = chunk->key[0];
+    objects[i].key[1] = chunk->key[1];
+    objects[i].offset = store->pack_size;
+    objects[i].size = chunk->size;
+    store->pack_size += chunk->size;
+    table_insert(&store->table, &objects[i]);
+
+    added[added_count++] = objects[i];
+    added_size += chunk->size;
+  }
+
+  if (added_count > 0) {
+    if (commit_file(store->pack, "pack") != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+
+    WRITE_FILE_WITH_ERROR_HANDLE(store->index, added, sizeof (ArchiveObject), added_count);
+    if (commit_file(store->index, "index") != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  uint32_t version = store->version_count + 1;
+  ArchiveRecipeHeader header;
+  memset(&header, 0, sizeof (header));
+  header.signature = ARCHIVE_RECIPE_SIGNATURE;
+  header.version = ARCHIVE_RECIPE_VERSION;
+  header.object_count = (uint32_t) job->chunk_count;
+  header.file_size = job->file_size;
+
+  char *filename = recipe_path(store->directory, version, job->arena);
+  FILE *fp = NULL;
+  OPEN_FILE_WITH_ERROR_HANDLE(filename, "wb", fp);
+  WRITE_FILE_WITH_ERROR_HANDLE(fp, &header, sizeof (header), 1);
+  WRITE_FILE_WITH_ERROR_HANDLE(fp, objects, sizeof (ArchiveObject), job->chunk_count);
+  if (commit_file(fp, "recipe") != EXIT_SUCCESS) {
+    fclose(fp);
+    return EXIT_FAILURE;
+  }
+  if (fclose(fp) != 0) {
+    printf_error("Closing recipe \"%s\" failed with error(%d): %s", filename, errno, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  fprintf(store->versions, "%u,", version);
+  csv_string(store->versions, job->filename);
+  fprintf(store->versions, ",%llu,%u,%llu,%llu,%llu\n", job->file_size, job->compressed, job->chunk_count, added_count, added_size);
+  if (commit_file(store->versions, "versions") != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  store->version_count = version;
+
+  printf_verbose(verbose, "Archived \"%s\" as version %u: %llu %s objects, %llu new (%llu of %llu bytes stored)",
+    job->filename, version, job->chunk_count, job->compressed ? "compressed" : "raw", added_count, added_size, job->file_size
+  );
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Load the pack index into the table and open every archive file for appending,
+ * an index entry torn by an interrupted ingest is dropped
+ */
+static int open_store(ArchiveStore *store, Arena *arena, bool verbose) {
+  if (!CreateDirectoryA(store->directory, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+    printf_error("CreateDirectoryA(\"%s\"); failed with error code %lu", store->directory, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  store->table.capacity = ARCHIVE_TABLE_CAPACITY;
+  SAFE_ALLOC_SIZE(ArchiveObject, slots, sizeof (ArchiveObject) * store->table.capacity);
+  store->table.slots = slots;
+
+  char *pack_filename = archive_path(store->directory, ARCHIVE_PACK_FILENAME, arena);
+  OPEN_FILE_WITH_ERROR_HANDLE(pack_filename, "a+b", store->pack);
+  _fseeki64(store->pack, 0, SEEK_END);
+  store->pack_size = _ftelli64(store->pack);
+
+  size_t index_size = 0;
+  byte *index = NULL;
+  char *index_filename = archive_path(store->directory, ARCHIVE_INDEX_FILENAME, arena);
+  FILE *fp = fopen(index_filename, "rb");
+  if (fp != NULL) {
+    fclose(fp);
+    index = read_file(index_filename, &index_size, arena);
+    if (index == NULL) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  size_t entry_count = index_size / sizeof (ArchiveObject);
+  for (size_t i = 0; i < entry_count; i++) {
+    ArchiveObject object;
+    memcpy(&object, index + i * sizeof (object), sizeof (object));
+    if (object.size == 0 || object.offset > store->pack_size || object.size > store->pack_size - object.offset) {
+      printf_error("Archive index entry #%llu at offset %llu of %llu bytes is past the end of the %llu bytes pack",
+        i, object.offset, object.size, store->pack_size
+      );
+      return EXIT_FAILURE;
+    }
+    table_insert(&store->table, &object);
+  }
+
+  bool torn = entry_count * sizeof (ArchiveObject) != index_size;
+  OPEN_FILE_WITH_ERROR_HANDLE(index_filename, torn ? "wb" : "ab", store->index);
+  if (torn) {
+    printf_verbose(verbose, "Dropping %llu bytes of torn archive index entry", index_size - entry_count * sizeof (ArchiveObject));
+    WRITE_FILE_WITH_ERROR_HANDLE(store->index, index, sizeof (ArchiveObject), entry_count);
+  }
+
+  size_t versions_size = 0;
+  byte *versions = NULL;
+  char *versions_filename = archive_path(store->directory, ARCHIVE_VERSIONS_FILENAME, arena);
+  fp = fopen(versions_filename, "rb");
+  if (fp != NULL) {
+    fclose(fp);
+    versions = read_file(versions_filename, &versions_size, arena);
+    if (versions == NULL) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  /**
+   * Every row but the column names is a version
+   */
+  for (size_t i = 0; i < versions_size; i++) {
+    store->version_count += versions[i] == '\n';
+  }
+  store->version_count -= store->version_count > 0;
+
+  OPEN_FILE_WITH_ERROR_HANDLE(versions_filename, "ab", store->versions);
+  if (versions_size == 0) {
+    fprintf(store->versions, "version,file,file_size,compressed,objects,new_objects,new_bytes\n");
+  }
+
+  printf_verbose(verbose, "Archive \"%s\": %u version(s), %llu object(s) in %llu bytes pack",
+    store->directory, store->version_count, store->table.count, store->pack_size
+  );
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Ingest every save as a new version, saves are read, split and keyed
+ * in parallel and committed one by one in input order
+ */
+int archive(const char *directory, int count, const char *filenames[], bool verbose) {
+  printf("Trying to archive %d save file(s) into \"%s\"\n", count, directory);
+
+  Arena *arena = arena_create(false);
+  ArchiveStore store;
+  memset(&store, 0, sizeof (store));
+  store.directory = directory;
+  if (open_store(&store, arena, verbose) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  SAFE_ALLOC_SIZE(ArchiveJob, jobs, sizeof (ArchiveJob) * count);
+  SAFE_ALLOC_SIZE(PoolTask *, tasks, sizeof (PoolTask *) * count);
+
+  /**
+   * Only a window of saves is held in memory at once
+   */
+  int window = (int) pool_size() * 2;
+  window = window > 0 ? window : 1;
+  printf_verbose(verbose, "Archiving with %u worker thread(s), %d save(s) in flight", pool_size(), window);
+
+  for (int i = 0; i < count && i < window; i++) {
+    jobs[i].filename = filenames[i];
+    jobs[i].arena = arena_create(false);
+    tasks[i] = pool_submit(ingest_task, &jobs[i]);
+  }
+
+  int failed = 0;
+  uint64_t total_size = 0;
+  uint64_t stored_size = store.pack_size;
+  for (int i = 0; i < count; i++) {
+    pool_wait(tasks[i]);
+
+    if (jobs[i].failed) {
+      printf_error("Failed to archive \"%s\"", jobs[i].filename);
+      failed++;
+    } else {
+      if (commit_version(&store, &jobs[i], verbose) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+      }
+      total_size += jobs[i].file_size;
+    }
+    arena_release(jobs[i].arena);
+
+    int next = i + window;
+    if (next < count) {
+      jobs[next].filename = filenames[next];
+      jobs[next].arena = arena_create(false);
+      tasks[next] = pool_submit(ingest_task, &jobs[next]);
+    }
+  }
+  stored_size = store.pack_size - stored_size;
+
+  fclose(store.versions);
+  fclose(store.index);
+  fclose(store.pack);
+  free(store.table.slots);
+  free(tasks);
+  free(jobs);
+  arena_release(arena);
+
+  printf("Archived %d of %d save file(s), %llu bytes stored for %llu bytes ingested\n", count - failed, count, stored_size, total_size);
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * WriteFile() takes a DWORD, large runs go out in pieces
+ */
+static bool write_range(HANDLE file, const byte *address, uint64_t size) {
+  while (size > 0) {
+    DWORD piece = (DWORD) (size > ARCHIVE_WRITE_SIZE ? ARCHIVE_WRITE_SIZE : size);
+    DWORD written = 0;
+    if (!WriteFile(file, address, piece, &written, NULL) || written != piece) {
+      return false;
+    }
+
+    address += piece;
+    size -= piece;
+  }
+
+  return true;
+}
+
+/**
+ * Assemble a version from its recipe, objects are written
+ * straight from the mapped pack without an intermediate copy
+ */
+int restore(const char *directory, const char *version, const char *output_filename, bool verbose) {
+  char *end = NULL;
+  unsigned long number = strtoul(version, &end, 10);
+  if (end == version || *end != '\0' || number == 0 || number > UINT32_MAX) {
+    printf_error("Invalid archive version \"%s\"", version);
+    return EXIT_FAILURE;
+  }
+
+  printf("Trying to restore version %lu from \"%s\"\n", number, directory);
+
+  Arena *arena = arena_create(false);
+  char *filename = recipe_path(directory, (uint32_t) number, arena);
+  size_t recipe_size = 0;
+  byte *recipe = read_file(filename, &recipe_size, arena);
+  if (recipe == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  ArchiveRecipeHeader header;
+  memset(&header, 0, sizeof (header));
+  if (recipe_size >= sizeof (header)) {
+    memcpy(&header, recipe, sizeof (header));
+  }
+
+  if (header.signature != ARCHIVE_RECIPE_SIGNATURE || header.version != ARCHIVE_RECIPE_VERSION || header.object_count == 0
+    || recipe_size != sizeof (header) + (size_t) header.object_count * sizeof (ArchiveObject)
+  ) {
+    printf_error("Recipe \"%s\" is malformed", filename);
+    return EXIT_FAILURE;
+  }
+  ArchiveObject *objects = (ArchiveObject *) (recipe + sizeof (header));
+
+  char *pack_filename = archive_path(directory, ARCHIVE_PACK_FILENAME, arena);
+  HANDLE pack = CreateFileA(pack_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (pack == INVALID_HANDLE_VALUE) {
+    printf_error("CreateFileA(\"%s\"); failed with error code %lu", pack_filename, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  LARGE_INTEGER pack_size;
+  if (!GetFileSizeEx(pack, &pack_size)) {
+    printf_error("GetFileSizeEx(\"%s\"); failed with error code %lu", pack_filename, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  uint64_t total_size = 0;
+  for (uint32_t i = 0; i < header.object_count; i++) {
+    if (objects[i].size == 0 || objects[i].offset > (uint64_t) pack_size.QuadPart
+      || objects[i].size > (uint64_t) pack_size.QuadPart - objects[i].offset
+    ) {
+      printf_error("Recipe object #%u at offset %llu of %llu bytes is past the end of the %lld bytes pack",
+        i, objects[i].offset, objects[i].size, pack_size.QuadPart
+      );
+      return EXIT_FAILURE;
+    }
+    total_size += objects[i].size;
+  }
+
+  if (total_size != header.file_size) {
+    printf_error("Recipe objects add up to %llu bytes, expected %llu", total_size, header.file_size);
+    return EXIT_FAILURE;
+  }
+
+  HANDLE mapping = CreateFileMappingA(pack, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    printf_error("CreateFileMappingA(\"%s\"); failed with error code %lu", pack_filename, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  const byte *view = (const byte *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    printf_error("MapViewOfFile(\"%s\"); failed with error code %lu", pack_filename, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  HANDLE output = CreateFileA(output_filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (output == INVALID_HANDLE_VALUE) {
+    printf_error("CreateFileA(\"%s\"); failed with error code %lu", output_filename, GetLastError());
+    return EXIT_FAILURE;
+  }
+
+  LARGE_INTEGER frequency, start, stop;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+
+  /**
+   * Objects stored back to back in the pack go out in a single write
+   */
+  uint32_t writes = 0;
+  uint64_t run_offset = objects[0].offset;
+  uint64_t run_size = objects[0].size;
+  for (uint32_t i = 1; i <= header.object_count; i++) {
+    if (i < header.object_count && objects[i].offset == run_offset + run_size) {
+      run_size += objects[i].size;
+      continue;
+    }
+
+    if (!write_range(output, view + run_offset, run_size)) {
+      printf_error("Writing to \"%s\" failed with error code %lu", output_filename, GetLastError());
+      return EXIT_FAILURE;
+    }
+    writes++;
+
+    if (i < header.object_count) {
+      run_offset = objects[i].offset;
+      run_size = objects[i].size;
+    }
+  }
+
+  QueryPerformanceCounter(&stop);
+  double seconds = (double) (stop.QuadPart - start.QuadPart) / (double) frequency.QuadPart;
+  printf_verbose(verbose, "Restored %llu bytes from %u object(s) in %u write(s), %.3f ms (%.1f MB/s)",
+    total_size, header.object_count, writes, seconds * 1000.0,
+    seconds > 0 ? (double) total_size / seconds / (1024.0 * 1024.0) : 0.0
+  );
+
+  CloseHandle(output);
+  UnmapViewOfFile(view);
+  CloseHandle(mapping);
+  CloseHandle(pack);
+  arena_release(arena);
+
+  printf("Successfully restored version %lu to \"%s\"\n", number, output_filename);
+
+  return EXIT_SUCCESS;
+}
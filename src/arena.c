@@ -0,0 +1,122 @@
+#include "arena.h"
+
+/**
+ * Large pages need SeLockMemoryPrivilege enabled in the process token,
+ * users have to be granted "Lock pages in memory" for this to succeed
+ */
+static bool arena_enable_large_pages() {
+  HANDLE token = NULL;
+  if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+    return false;
+  }
+
+  TOKEN_PRIVILEGES privileges;
+  privileges.PrivilegeCount = 1;
+  privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+  bool enabled = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+    && AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL)
+    && GetLastError() == ERROR_SUCCESS;
+
+  CloseHandle(token);
+
+  return enabled;
+}
+
+/**
+ * Map dedicated pages for the block, the OS hands them out zeroed
+ */
+static ArenaBlock *arena_map(Arena *arena, size_t size) {
+  ArenaBlock *block = NULL;
+  size_t mapped_size = size + ARENA_HEADER_SIZE;
+
+  if (arena->huge_pages && mapped_size >= arena->large_page_size) {
+    size_t large_size = (mapped_size + arena->large_page_size - 1) & ~(arena->large_page_size - 1);
+    block = (ArenaBlock *) VirtualAlloc(NULL, large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (block != NULL) {
+      mapped_size = large_size;
+    }
+  }
+
+  if (block == NULL) {
+    block = (ArenaBlock *) VirtualAlloc(NULL, mapped_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  }
+
+  if (block == NULL) {
+    printf_error("VirtualAlloc(); failed to map %llu bytes with error code %lu", mapped_size, GetLastError());
+    exit(EXIT_FAILURE);
+  }
+
+  block->size = mapped_size - ARENA_HEADER_SIZE;
+  block->used = 0;
+  arena->allocated += mapped_size;
+
+  return block;
+}
+
+Arena *arena_create(bool huge_pages) {
+  SAFE_ALLOC(Arena, arena);
+
+  if (huge_pages) {
+    arena->large_page_size = GetLargePageMinimum();
+    arena->huge_pages = arena->large_page_size > 0 && arena_enable_large_pages();
+  }
+
+  return arena;
+}
+
+void *arena_alloc(Arena *arena, size_t size, ArenaKind kind) {
+  if (size >= ARENA_LARGE_SIZE) {
+    ArenaBlock *block = arena_map(arena, size);
+    block->used = size;
+    block->next = arena->large;
+    arena->large = block;
+
+    return (byte *) block + ARENA_HEADER_SIZE;
+  }
+
+  size = (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+
+  ArenaBlock *block = arena->blocks;
+  if (block == NULL || block->used + size > block->size) {
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    block = (ArenaBlock *) malloc(ARENA_HEADER_SIZE + block_size);
+    if (block == NULL) {
+      printf_error("malloc(); failed to allocate arena block of %llu bytes with error(%d): %s", block_size, errno, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->allocated += ARENA_HEADER_SIZE + block_size;
+  }
+
+  byte *pointer = (byte *) block + ARENA_HEADER_SIZE + block->used;
+  block->used += size;
+
+  if (kind == ARENA_ZEROED) {
+    memset(pointer, 0, size);
+  }
+
+  return pointer;
+}
+
+/**
+ * Release everything allocated during the job at once
+ */
+void arena_release(Arena *arena) {
+  while (arena->blocks != NULL) {
+    ArenaBlock *next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = next;
+  }
+
+  while (arena->large != NULL) {
+    ArenaBlock *next = arena->large->next;
+    VirtualFree(arena->large, 0, MEM_RELEASE);
+    arena->large = next;
+  }
+
+  free(arena);
+}
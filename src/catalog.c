@@ -0,0 +1,393 @@
+#include "catalog.h"
+
+// Bytes fetched per read, GVAS head usually fits in one window
+#define CATALOG_WINDOW_SIZE 65536
+#define CATALOG_STRING_MAX 256
+#define CATALOG_PROPERTIES_MAX 4096
+#define CATALOG_ERROR_MAX 128
+
+// Custom version entry (GUID + version) of custom version format 3
+#define GVAS_CUSTOM_VERSION_FORMAT 3
+#define GVAS_CUSTOM_VERSION_SIZE 20
+#define GVAS_GUID_SIZE 16
+
+/**
+ * Sliding window over the file, refilled with `pread()`
+ * only when the requested range is not already buffered
+ */
+typedef struct _CATALOG_READER {
+  HANDLE file;
+  uint64_t file_size;
+  uint64_t position;
+  uint64_t window_offset;
+  size_t window_size;
+  size_t capacity;
+  byte *window;
+  uint64_t bytes_read;
+} CatalogReader;
+
+typedef struct _CATALOG_ENTRY {
+  const char *filename;
+  uint64_t file_size;
+  uint64_t bytes_read;
+  GvasHeader header;
+  char branch[CATALOG_STRING_MAX];
+  char save_class[CATALOG_STRING_MAX];
+  uint64_t database_offset;
+  uint64_t database_size;
+  char properties[CATALOG_PROPERTIES_MAX];
+  size_t properties_length;
+  char error[CATALOG_ERROR_MAX];
+} CatalogEntry;
+
+/**
+ * Return pointer to `length` bytes at the current position and advance,
+ * NULL when the range is outside of the file or reading failed
+ */
+static const byte *reader_fetch(CatalogReader *reader, size_t length) {
+  if (reader->position > reader->file_size || length > reader->file_size - reader->position) {
+    return NULL;
+  }
+
+  if (reader->position < reader->window_offset
+    || reader->position + length > reader->window_offset + reader->window_size
+  ) {
+    if (length > reader->capacity) {
+      byte *window = realloc(reader->window, length);
+      if (window == NULL) {
+        return NULL;
+      }
+      reader->window = window;
+      reader->capacity = length;
+    }
+
+    size_t size = reader->capacity;
+    if (reader->position + size > reader->file_size) {
+      size = (size_t) (reader->file_size - reader->position);
+    }
+
+    if (pread(reader->file, reader->window, size, reader->position) != (int64_t) size) {
+      return NULL;
+    }
+
+    reader->window_offset = reader->position;
+    reader->window_size = size;
+    reader->bytes_read += size;
+  }
+
+  const byte *pointer = reader->window + (reader->position - reader->window_offset);
+  reader->position += length;
+
+  return pointer;
+}
+
+static bool reader_read(CatalogReader *reader, void *destination, size_t length) {
+  const byte *pointer = reader_fetch(reader, length);
+  if (pointer == NULL) {
+    return false;
+  }
+
+  memcpy(destination, pointer, length);
+
+  return true;
+}
+
+/**
+ * Read FString into null terminated buffer, truncating if needed
+ * UCS2 strings are narrowed, non ASCII characters become '?'
+ */
+static bool reader_fstring(CatalogReader *reader, char *string, size_t capacity) {
+  int32_t length = 0;
+  if (!reader_read(reader, &length, sizeof (length))) {
+    return false;
+  }
+
+  string[0] = '\0';
+  if (length == 0) {
+    return true;
+  }
+
+  bool ucs2 = length < 0;
+  size_t characters = ucs2 ? (size_t) -(int64_t) length : (size_t) length;
+  const byte *data = reader_fetch(reader, characters * (ucs2 ? 2 : 1));
+  if (data == NULL) {
+    return false;
+  }
+
+  size_t copy = characters < capacity ? characters : capacity - 1;
+  for (size_t i = 0; i < copy; i++) {
+    if (ucs2) {
+      uint16_t character = (uint16_t) (data[i * 2] | (data[i * 2 + 1] << 8));
+      string[i] = character < 0x80 ? (char) character : '?';
+    } else {
+      string[i] = (char) data[i];
+    }
+  }
+  string[copy] = '\0';
+
+  return true;
+}
+
+/**
+ * Append `name=value` to the entry properties list
+ */
+static void catalog_append(CatalogEntry *entry, const char *name, const char *format, ...) {
+  char value[CATALOG_STRING_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(value, sizeof (value), format, args);
+  va_end(args);
+
+  int written = snprintf(entry->properties + entry->properties_length, sizeof (entry->properties) - entry->properties_length,
+    "%s%s=%s", entry->properties_length > 0 ? ";" : "", name, value
+  );
+  if (written > 0) {
+    entry->properties_length += written;
+    if (entry->properties_length >= sizeof (entry->properties)) {
+      entry->properties_length = sizeof (entry->properties) - 1;
+    }
+  }
+}
+
+/**
+ * Walk top level properties until "None", values of scalar
+ * properties are read, everything else is skipped by its length
+ */
+static bool catalog_properties(CatalogReader *reader, CatalogEntry *entry) {
+  char name[CATALOG_STRING_MAX];
+  char type[CATALOG_STRING_MAX];
+  char inner[CATALOG_STRING_MAX];
+
+  while (true) {
+    if (!reader_fstring(reader, name, sizeof (name))) {
+      snprintf(entry->error, sizeof (entry->error), "Truncated property name at offset %llu", reader->position);
+      return false;
+    }
+
+    if (name[0] == '\0' || strcmp(name, "None") == 0) {
+      return true;
+    }
+
+    uint64_t length = 0;
+    if (!reader_fstring(reader, type, sizeof (type)) || !reader_read(reader, &length, sizeof (length))) {
+      snprintf(entry->error, sizeof (entry->error), "Truncated property \"%s\"", name);
+      return false;
+    }
+
+    /**
+     * Type specific tag data precedes the optional property GUID
+     */
+    bool tag_ok = true;
+    uint8_t bool_value = 0;
+    inner[0] = '\0';
+    if (strcmp(type, "StructProperty") == 0) {
+      tag_ok = reader_fstring(reader, inner, sizeof (inner));
+      reader->position += GVAS_GUID_SIZE;
+    } else if (strcmp(type, "ArrayProperty") == 0 || strcmp(type, "SetProperty") == 0
+      || strcmp(type, "ByteProperty") == 0 || strcmp(type, "EnumProperty") == 0
+    ) {
+      tag_ok = reader_fstring(reader, inner, sizeof (inner));
+    } else if (strcmp(type, "MapProperty") == 0) {
+      tag_ok = reader_fstring(reader, inner, sizeof (inner)) && reader_fstring(reader, inner, sizeof (inner));
+    } else if (strcmp(type, "BoolProperty") == 0) {
+      tag_ok = reader_read(reader, &bool_value, sizeof (bool_value));
+    }
+
+    uint8_t has_guid = 0;
+    if (!tag_ok || !reader_read(reader, &has_guid, sizeof (has_guid))) {
+      snprintf(entry->error, sizeof (entry->error), "Truncated \"%s\" tag of property \"%s\"", type, name);
+      return false;
+    }
+    if (has_guid != 0) {
+      reader->position += GVAS_GUID_SIZE;
+    }
+
+    uint64_t value_offset = reader->position;
+    if (value_offset > reader->file_size || length > reader->file_size - value_offset) {
+      snprintf(entry->error, sizeof (entry->error), "Property \"%s\" length %llu exceeds file size", name, length);
+      return false;
+    }
+
+    if (strcmp(name, RDI_UPROPERTY_NAME) == 0) {
+      entry->database_offset = value_offset;
+      entry->database_size = length;
+    } else if (strcmp(type, "BoolProperty") == 0) {
+      catalog_append(entry, name, "%u", bool_value);
+    } else if (strcmp(type, "IntProperty") == 0 && length == sizeof (int32_t)) {
+      int32_t value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%d", value);
+    } else if (strcmp(type, "UInt32Property") == 0 && length == sizeof (uint32_t)) {
+      uint32_t value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%u", value);
+    } else if (strcmp(type, "Int64Property") == 0 && length == sizeof (int64_t)) {
+      int64_t value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%lld", value);
+    } else if (strcmp(type, "UInt64Property") == 0 && length == sizeof (uint64_t)) {
+      uint64_t value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%llu", value);
+    } else if (strcmp(type, "FloatProperty") == 0 && length == sizeof (float)) {
+      float value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%g", value);
+    } else if (strcmp(type, "DoubleProperty") == 0 && length == sizeof (double)) {
+      double value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%g", value);
+    } else if (strcmp(type, "ByteProperty") == 0 && length == sizeof (uint8_t)) {
+      uint8_t value = 0;
+      reader_read(reader, &value, sizeof (value));
+      catalog_append(entry, name, "%u", value);
+    } else if (strcmp(type, "StrProperty") == 0 || strcmp(type, "NameProperty") == 0
+      || strcmp(type, "EnumProperty") == 0 || strcmp(type, "ByteProperty") == 0
+    ) {
+      char value[CATALOG_STRING_MAX];
+      if (reader_fstring(reader, value, sizeof (value))) {
+        catalog_append(entry, name, "%s", value);
+      }
+    }
+
+    reader->position = value_offset + length;
+  }
+}
+
+/**
+ * Catalog a single save file, runs on the worker pool
+ */
+static void catalog_task(void *argument) {
+  CatalogEntry *entry = (CatalogEntry *) argument;
+
+  HANDLE file = CreateFileA(entry->filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    snprintf(entry->error, sizeof (entry->error), "CreateFileA() failed with error code %lu", GetLastError());
+    return;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    snprintf(entry->error, sizeof (entry->error), "GetFileSizeEx() failed with error code %lu", GetLastError());
+    CloseHandle(file);
+    return;
+  }
+
+  SAFE_ALLOC_SIZE(byte, window, CATALOG_WINDOW_SIZE);
+  CatalogReader reader = {
+    .file = file,
+    .file_size = (uint64_t) file_size.QuadPart,
+    .capacity = CATALOG_WINDOW_SIZE,
+    .window = window
+  };
+  entry->file_size = reader.file_size;
+
+  int32_t custom_version_format = 0;
+  int32_t custom_version_count = 0;
+  if (!reader_read(&reader, &entry->header, sizeof (entry->header))) {
+    snprintf(entry->error, sizeof (entry->error), "Truncated GVAS header");
+  } else if (entry->header.signature != GVAS_HEADER_SIGNATURE) {
+    snprintf(entry->error, sizeof (entry->error), "Invalid GVAS header signature 0x%08X", _byteswap_ulong(entry->header.signature));
+  } else if (entry->header.version != GVAS_HEADER_VERSION) {
+    snprintf(entry->error, sizeof (entry->error), "Invalid GVAS header version %u", entry->header.version);
+  } else if (!reader_fstring(&reader, entry->branch, sizeof (entry->branch))
+    || !reader_read(&reader, &custom_version_format, sizeof (custom_version_format))
+    || !reader_read(&reader, &custom_version_count, sizeof (custom_version_count))
+  ) {
+    snprintf(entry->error, sizeof (entry->error), "Truncated GVAS engine version");
+  } else if (custom_version_format != GVAS_CUSTOM_VERSION_FORMAT || custom_version_count < 0) {
+    snprintf(entry->error, sizeof (entry->error), "Unsupported custom version format %d", custom_version_format);
+  } else {
+    reader.position += (uint64_t) custom_version_count * GVAS_CUSTOM_VERSION_SIZE;
+    if (!reader_fstring(&reader, entry->save_class, sizeof (entry->save_class))) {
+      snprintf(entry->error, sizeof (entry->error), "Truncated save game class name");
+    } else {
+      catalog_properties(&reader, entry);
+    }
+  }
+
+  entry->bytes_read = reader.bytes_read;
+
+  free(reader.window);
+  CloseHandle(file);
+}
+
+int catalog(const char *index_filename, int count, const char *filenames[], bool verbose) {
+  printf("Trying to catalog %d save file(s) into \"%s\"\n", count, index_filename);
+
+  FILE *fpout = NULL;
+  OPEN_FILE_WITH_ERROR_HANDLE(index_filename, "wb", fpout);
+
+  /**
+   * Only a window of saves is in flight, every entry slot
+   * is reused once its row is written
+   */
+  int window = (int) pool_size() * 2;
+  window = window < count ? window : count;
+  window = window > 0 ? window : 1;
+  printf_verbose(verbose, "Cataloging with %u worker thread(s), %d save(s) in flight", pool_size(), window);
+
+  SAFE_ALLOC_SIZE(CatalogEntry, entries, sizeof (CatalogEntry) * window);
+  SAFE_ALLOC_SIZE(PoolTask *, tasks, sizeof (PoolTask *) * window);
+
+  for (int i = 0; i < count && i < window; i++) {
+    entries[i].filename = filenames[i];
+    tasks[i] = pool_submit(catalog_task, &entries[i]);
+  }
+
+  fprintf(fpout, "file,file_size,bytes_read,save_game_version,package_version,engine_version,branch,save_class,database_offset,database_size,properties,error\n");
+
+  int failed = 0;
+  uint64_t total_size = 0;
+  uint64_t total_read = 0;
+  for (int i = 0; i < count; i++) {
+    int slot = i % window;
+    pool_wait(tasks[slot]);
+
+    CatalogEntry *entry = &entries[slot];
+    total_size += entry->file_size;
+    total_read += entry->bytes_read;
+
+    if (entry->error[0] != '\0') {
+      printf_error("Failed to catalog \"%s\": %s", entry->filename, entry->error);
+      failed++;
+    } else {
+      printf_verbose(verbose, "Cataloged \"%s\" reading %llu of %llu bytes", entry->filename, entry->bytes_read, entry->file_size);
+    }
+
+    csv_string(fpout, entry->filename);
+    fprintf(fpout, ",%llu,%llu,%u,%u,%u.%u.%u-%u,",
+      entry->file_size, entry->bytes_read, entry->header.version, entry->header.package,
+      entry->header.engine.major, entry->header.engine.minor, entry->header.engine.patch,
+      entry->header.engine.changelist & 0x7fffffffu
+    );
+    csv_string(fpout, entry->branch);
+    fputc(',', fpout);
+    csv_string(fpout, entry->save_class);
+    fprintf(fpout, ",%llu,%llu,", entry->database_offset, entry->database_size);
+    csv_string(fpout, entry->properties);
+    fputc(',', fpout);
+    csv_string(fpout, entry->error);
+    fputc('\n', fpout);
+
+    int next = i + window;
+    if (next < count) {
+      memset(entry, 0, sizeof (CatalogEntry));
+      entry->filename = filenames[next];
+      tasks[slot] = pool_submit(catalog_task, entry);
+    }
+  }
+
+  if (ferror(fpout)) {
+    printf_error("Writing to index file \"%s\" failed", index_filename);
+    return EXIT_FAILURE;
+  }
+  fclose(fpout);
+
+  free(tasks);
+  free(entries);
+
+  printf("Cataloged %d of %d save file(s) reading %llu of %llu bytes\n", count - failed, count, total_read, total_size);
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,482 @@
+#include "compact.h"
+
+// SQLite never nests b-trees deeper than this
+#define BTREE_MAX_DEPTH 20
+
+/**
+ * Cell payload, `overflow` points at the first overflow page number
+ * stored right after the local part (NULL if the payload fits the page)
+ */
+typedef struct _CELL_PAYLOAD {
+  byte *local;
+  uint64_t local_size;
+  uint64_t size;
+  byte *overflow;
+} CellPayload;
+
+static uint32_t read_be16(const byte *source) {
+  uint16_t value;
+  memcpy(&value, source, sizeof (value));
+  return _byteswap_ushort(value);
+}
+
+static uint32_t read_be32(const byte *source) {
+  uint32_t value;
+  memcpy(&value, source, sizeof (value));
+  return _byteswap_ulong(value);
+}
+
+static void write_be32(byte *destination, uint32_t value) {
+  value = _byteswap_ulong(value);
+  memcpy(destination, &value, sizeof (value));
+}
+
+/**
+ * Read SQLite varint, returns its length or 0 if it runs past `end`
+ */
+static uint32_t read_varint(const byte *source, const byte *end, uint64_t *value) {
+  *value = 0;
+  for (uint32_t i = 0; i < 9 && source + i < end; i++) {
+    if (i == 8) {
+      *value = (*value << 8) | source[i];
+      return i + 1;
+    }
+
+    *value = (*value << 7) | (source[i] & 0x7F);
+    if ((source[i] & 0x80) == 0) {
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+static byte *page_address(const CompactContext *context, uint32_t page) {
+  return context->image + (size_t) (page - 1) * context->page_size;
+}
+
+/**
+ * Mark page as reached while classifying, every page may be reached once
+ */
+static bool claim(CompactContext *context, uint32_t page, PageKind kind) {
+  if (page < 1 || page > context->page_count) {
+    return false;
+  }
+
+  if (context->mapping != NULL) {
+    return true;
+  }
+
+  if (context->kinds[page] != PAGE_UNKNOWN) {
+    return false;
+  }
+
+  context->kinds[page] = (uint8_t) kind;
+  return true;
+}
+
+/**
+ * Read page number stored in `field` and rewrite it through the mapping,
+ * returns the page number as it was before
+ */
+static uint32_t patch(CompactContext *context, byte *field) {
+  uint32_t page = read_be32(field);
+  if (context->mapping != NULL && page >= 1 && page <= context->page_count) {
+    write_be32(field, context->mapping[page]);
+  }
+
+  return page;
+}
+
+/**
+ * Address of a payload byte, following the overflow chain if needed
+ */
+static byte *payload_byte(const CompactContext *context, const CellPayload *payload, uint64_t offset) {
+  if (offset < payload->local_size) {
+    return payload->local + offset;
+  }
+
+  if (payload->overflow == NULL || offset >= payload->size) {
+    return NULL;
+  }
+
+  offset -= payload->local_size;
+  uint32_t page = read_be32(payload->overflow);
+  while (page >= 1 && page <= context->page_count) {
+    byte *address = page_address(context, page);
+    if (offset < context->usable_size - 4) {
+      return address + 4 + offset;
+    }
+
+    offset -= context->usable_size - 4;
+    page = read_be32(address);
+  }
+
+  return NULL;
+}
+
+static bool payload_varint(const CompactContext *context, const CellPayload *payload, uint64_t *offset, uint64_t *value) {
+  *value = 0;
+  for (uint32_t i = 0; i < 9; i++) {
+    byte *source = payload_byte(context, payload, (*offset)++);
+    if (source == NULL) {
+      return false;
+    }
+
+    if (i == 8) {
+      *value = (*value << 8) | *source;
+      return true;
+    }
+
+    *value = (*value << 7) | (*source & 0x7F);
+    if ((*source & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Size of a record column of the given serial type
+ */
+static uint64_t serial_size(uint64_t type) {
+  static const uint8_t sizes[12] = { 0, 1, 2, 3, 4, 6, 8, 8, 0, 0, 0, 0 };
+  return type >= 12 ? (type - 12) / 2 : sizes[type];
+}
+
+/**
+ * Root page of a `sqlite_schema` record, 0 for views and triggers,
+ * the value is rewritten in place keeping its serial type
+ */
+static bool schema_root(CompactContext *context, const CellPayload *payload, uint32_t *root) {
+  *root = 0;
+
+  uint64_t offset = 0;
+  uint64_t header_size = 0;
+  if (!payload_varint(context, payload, &offset, &header_size)) {
+    return false;
+  }
+
+  uint64_t column_offset = header_size;
+  uint64_t type = 0;
+  for (uint32_t column = 0; column <= SQLITE_SCHEMA_ROOTPAGE_COLUMN; column++) {
+    if (offset >= header_size || !payload_varint(context, payload, &offset, &type)) {
+      return false;
+    }
+
+    if (column < SQLITE_SCHEMA_ROOTPAGE_COLUMN) {
+      column_offset += serial_size(type);
+    }
+  }
+
+  if (type == 0 || type == 8) {
+    return true;
+  }
+
+  if (type < 1 || type > 6) {
+    return false;
+  }
+
+  uint64_t width = serial_size(type);
+  uint64_t value = 0;
+  for (uint64_t i = 0; i < width; i++) {
+    byte *source = payload_byte(context, payload, column_offset + i);
+    if (source == NULL) {
+      return false;
+    }
+    value = (value << 8) | *source;
+  }
+
+  if (value < 2 || value > context->page_count) {
+    return false;
+  }
+
+  *root = (uint32_t) value;
+  if (context->mapping != NULL) {
+    uint64_t mapped = context->mapping[value];
+    for (uint64_t i = width; i-- > 0; mapped >>= 8) {
+      *payload_byte(context, payload, column_offset + i) = (byte) mapped;
+    }
+  }
+
+  return true;
+}
+
+static bool walk_overflow(CompactContext *context, byte *field, uint64_t remaining) {
+  uint32_t overflow_size = context->usable_size - 4;
+  while (remaining > 0) {
+    uint32_t page = patch(context, field);
+    if (!claim(context, page, PAGE_OVERFLOW)) {
+      return false;
+    }
+
+    field = page_address(context, page);
+    remaining -= remaining < overflow_size ? remaining : overflow_size;
+  }
+
+  return true;
+}
+
+/**
+ * Walk b-tree rooted at `page`, for `sqlite_schema` (page 1)
+ * the tables and indexes it lists are walked as well
+ */
+static bool walk_btree(CompactContext *context, uint32_t page, bool schema, uint32_t depth) {
+  if (depth > BTREE_MAX_DEPTH || !claim(context, page, PAGE_BTREE)) {
+    return false;
+  }
+
+  byte *address = page_address(context, page);
+  byte *end = address + context->usable_size;
+  byte *header = address + (page == 1 ? SQLITE_HEADER_SIZE : 0);
+
+  byte type = header[0];
+  bool leaf = type == SQLITE_PAGE_LEAF_INDEX || type == SQLITE_PAGE_LEAF_TABLE;
+  bool table = type == SQLITE_PAGE_INTERIOR_TABLE || type == SQLITE_PAGE_LEAF_TABLE;
+  if (!leaf && type != SQLITE_PAGE_INTERIOR_INDEX && type != SQLITE_PAGE_INTERIOR_TABLE) {
+    return false;
+  }
+
+  if (schema && !table) {
+    return false;
+  }
+
+  uint32_t cell_count = read_be16(header + 3);
+  byte *pointers = header + (leaf ? 8 : 12);
+  byte *pointers_end = pointers + 2 * (size_t) cell_count;
+  if (pointers_end > end) {
+    return false;
+  }
+
+  /**
+   * NOTE: Payload spills to overflow pages past `max_local` bytes,
+   * see "Cell Payload Overflow Pages" in the SQLite file format
+   */
+  uint64_t max_local = table ? context->usable_size - 35 : (context->usable_size - 12) * 64 / 255 - 23;
+  uint64_t min_local = (context->usable_size - 12) * 32 / 255 - 23;
+
+  for (uint32_t i = 0; i < cell_count; i++) {
+    byte *cell = address + read_be16(pointers + 2 * i);
+    if (cell < pointers_end || cell + 4 > end) {
+      return false;
+    }
+
+    if (!leaf) {
+      uint32_t child = patch(context, cell);
+      if (!walk_btree(context, child, schema, depth + 1)) {
+        return false;
+      }
+
+      if (table) {
+        continue;
+      }
+      cell += 4;
+    }
+
+    uint64_t payload_size = 0;
+    uint32_t length = read_varint(cell, end, &payload_size);
+    if (length == 0) {
+      return false;
+    }
+    cell += length;
+
+    if (type == SQLITE_PAGE_LEAF_TABLE) {
+      uint64_t rowid = 0;
+      length = read_varint(cell, end, &rowid);
+      if (length == 0) {
+        return false;
+      }
+      cell += length;
+    }
+
+    CellPayload payload = { cell, payload_size, payload_size, NULL };
+    if (payload_size > max_local) {
+      uint64_t local_size = min_local + (payload_size - min_local) % (context->usable_size - 4);
+      payload.local_size = local_size <= max_local ? local_size : min_local;
+      payload.overflow = cell + payload.local_size;
+    }
+
+    if (payload.local_size > (uint64_t) (end - cell) || (payload.overflow != NULL && payload.overflow + 4 > end)) {
+      return false;
+    }
+
+    /**
+     * Root page number is read before the overflow chain it may live on
+     * gets rewritten
+     */
+    uint32_t root = 0;
+    if (schema && leaf && !schema_root(context, &payload, &root)) {
+      return false;
+    }
+
+    if (payload.overflow != NULL && !walk_overflow(context, payload.overflow, payload_size - payload.local_size)) {
+      return false;
+    }
+
+    if (root != 0 && !walk_btree(context, root, false, 0)) {
+      return false;
+    }
+  }
+
+  if (!leaf) {
+    uint32_t right = patch(context, header + 8);
+    if (!walk_btree(context, right, schema, depth + 1)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool walk_freelist(CompactContext *context, uint32_t trunk, uint32_t expected) {
+  uint32_t count = 0;
+  while (trunk != 0) {
+    if (!claim(context, trunk, PAGE_FREE)) {
+      return false;
+    }
+    count++;
+
+    byte *address = page_address(context, trunk);
+    uint32_t leaves = read_be32(address + 4);
+    if (leaves > context->usable_size / 4 - 2) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < leaves; i++) {
+      if (!claim(context, read_be32(address + 8 + 4 * i), PAGE_FREE)) {
+        return false;
+      }
+      count++;
+    }
+
+    trunk = read_be32(address);
+  }
+
+  return count == expected;
+}
+
+/**
+ * Drop the freelist of SQLite `image` in place,
+ * returns the new image size (unchanged if it was left alone)
+ */
+size_t compact(byte *image, size_t size, Arena *arena, bool verbose) {
+  printf_verbose(verbose, "Compacting SQLite database of %llu bytes...", size);
+
+  if (size < SQLITE_HEADER_SIZE || memcmp(image, SQLITE_HEADER_SIGNATURE, SQLITE_HEADER_SIGNATURE_LEN) != 0) {
+    printf_verbose(verbose, " Not a SQLite database, skipping compaction");
+    return size;
+  }
+
+  CompactContext context;
+  memset(&context, 0, sizeof (context));
+  context.image = image;
+  context.page_size = read_be16(image + SQLITE_HEADER_PAGE_SIZE);
+  context.page_size = context.page_size == 1 ? 65536 : context.page_size;
+  context.usable_size = context.page_size - image[SQLITE_HEADER_RESERVED];
+
+  if (context.page_size < 512 || context.usable_size < 480 || size % context.page_size != 0) {
+    printf_verbose(verbose, " Page size %lu does not divide image size, skipping compaction", context.page_size);
+    return size;
+  }
+
+  context.page_count = (uint32_t) (size / context.page_size);
+  if (read_be32(image + SQLITE_HEADER_DATABASE_SIZE) != context.page_count
+    || read_be32(image + SQLITE_HEADER_CHANGE_COUNTER) != read_be32(image + SQLITE_HEADER_VERSION_VALID_FOR)
+  ) {
+    printf_verbose(verbose, " Database size in header can not be trusted, skipping compaction");
+    return size;
+  }
+
+  if (read_be32(image + SQLITE_HEADER_LARGEST_ROOT) != 0) {
+    printf_verbose(verbose, " Auto-vacuum databases keep pointer maps, skipping compaction");
+    return size;
+  }
+
+  if (size > SQLITE_LOCK_BYTE_OFFSET) {
+    printf_verbose(verbose, " Database spans the lock-byte page, skipping compaction");
+    return size;
+  }
+
+  uint32_t free_count = read_be32(image + SQLITE_HEADER_FREELIST_COUNT);
+  if (free_count == 0) {
+    printf_verbose(verbose, " Freelist is empty, nothing to compact");
+    return size;
+  }
+
+  /**
+   * Classify every page first, nothing is touched
+   * unless all of them are accounted for
+   */
+  ARENA_ALLOC_SIZE(arena, uint8_t, kinds, context.page_count + 1, ARENA_ZEROED);
+  context.kinds = kinds;
+
+  if (!walk_freelist(&context, read_be32(image + SQLITE_HEADER_FREELIST_TRUNK), free_count)) {
+    printf_verbose(verbose, " Freelist is malformed, skipping compaction");
+    return size;
+  }
+
+  if (!walk_btree(&context, 1, true, 0)) {
+    printf_verbose(verbose, " B-tree pages are malformed, skipping compaction");
+    return size;
+  }
+
+  uint32_t unaccounted = 0;
+  for (uint32_t page = 1; page <= context.page_count; page++) {
+    unaccounted += kinds[page] == PAGE_UNKNOWN;
+  }
+
+  if (unaccounted > 0) {
+    printf_verbose(verbose, " %lu pages are not accounted for, skipping compaction", unaccounted);
+    return size;
+  }
+
+  /**
+   * Pages in use past the new end move to the lowest free slots,
+   * all other pages keep their numbers
+   */
+  uint32_t new_count = context.page_count - free_count;
+  ARENA_ALLOC_SIZE(arena, uint32_t, mapping, sizeof (uint32_t) * ((size_t) context.page_count + 1), ARENA_UNINITIALIZED);
+  for (uint32_t page = 0; page <= context.page_count; page++) {
+    mapping[page] = page;
+  }
+
+  uint32_t moved = 0;
+  uint32_t slot = 1;
+  for (uint32_t page = new_count + 1; page <= context.page_count; page++) {
+    if (kinds[page] == PAGE_FREE) {
+      continue;
+    }
+
+    while (kinds[slot] != PAGE_FREE) {
+      slot++;
+    }
+    mapping[page] = slot++;
+    moved++;
+  }
+
+  context.mapping = mapping;
+  walk_btree(&context, 1, true, 0);
+
+  for (uint32_t page = new_count + 1; page <= context.page_count; page++) {
+    if (mapping[page] != page) {
+      memcpy(page_address(&context, mapping[page]), page_address(&context, page), context.page_size);
+    }
+  }
+
+  /**
+   * Root pages may have moved, so bump schema cookie as VACUUM does
+   */
+  uint32_t change_counter = read_be32(image + SQLITE_HEADER_CHANGE_COUNTER) + 1;
+  write_be32(image + SQLITE_HEADER_CHANGE_COUNTER, change_counter);
+  write_be32(image + SQLITE_HEADER_VERSION_VALID_FOR, change_counter);
+  write_be32(image + SQLITE_HEADER_SCHEMA_COOKIE, read_be32(image + SQLITE_HEADER_SCHEMA_COOKIE) + 1);
+  write_be32(image + SQLITE_HEADER_DATABASE_SIZE, new_count);
+  write_be32(image + SQLITE_HEADER_FREELIST_TRUNK, 0);
+  write_be32(image + SQLITE_HEADER_FREELIST_COUNT, 0);
+
+  size_t new_size = (size_t) new_count * context.page_size;
+  printf_verbose(verbose, " Dropped %lu free pages, moved %lu pages, %llu bytes -> %llu bytes", free_count, moved, size, new_size);
+
+  return new_size;
+}
@@ -0,0 +1,103 @@
+#include "edit.h"
+
+#include <sqlite3.h>
+
+/**
+ * Read the whole SQL script into a null terminated buffer
+ */
+static char *read_script(const char *script_filename, Arena *arena, bool verbose) {
+  FILE *fpscript = NULL;
+  OPEN_FILE_WITH_ERROR_HANDLE(script_filename, "rb", fpscript);
+
+  fseek(fpscript, 0, SEEK_END);
+  size_t script_size = ftell(fpscript);
+  fseek(fpscript, 0, SEEK_SET);
+  printf_verbose(verbose, "SQL script \"%s\" size: %llu bytes", script_filename, script_size);
+
+  ARENA_ALLOC_SIZE(arena, char, script, script_size + 1, ARENA_UNINITIALIZED);
+  script[script_size] = '\0';
+  if (script_size > 0 && fread(script, script_size, 1, fpscript) != 1) {
+    printf_error("SQL script: fread(script, %llu, 1, fp); failed", script_size);
+    exit(EXIT_FAILURE);
+  }
+
+  fclose(fpscript);
+
+  return script;
+}
+
+void edit(UProperty *property, const char *script_filename, OodleLZ_Jobify jobify, uint32_t compress_flags, Arena *arena, bool verbose) {
+  UArrayProperty *data = (UArrayProperty *) property->data;
+
+  char *script = read_script(script_filename, arena, verbose);
+
+  /**
+   * Compressed stream stays valid in the arena after `decompress()`
+   */
+  UpkReuse reuse;
+  reuse.compressed.address = data->value;
+  reuse.compressed.size = data->size;
+
+  decompress(property, arena, verbose);
+
+  reuse.sqlite.address = data->value;
+  reuse.sqlite.size = data->size;
+
+  /**
+   * SQLite takes ownership of the deserialized buffer,
+   * hence it has to come from `sqlite3_malloc64()`
+   */
+  byte *image = sqlite3_malloc64(data->size);
+  if (image == NULL) {
+    printf_error("sqlite3_malloc64(%lu); failed to allocate database image", data->size);
+    exit(EXIT_FAILURE);
+  }
+  memcpy(image, data->value, data->size);
+
+  sqlite3 *db = NULL;
+  int rc = sqlite3_open(":memory:", &db);
+  if (rc != SQLITE_OK) {
+    printf_error("sqlite3_open(\":memory:\"); failed with error(%d): %s", rc, sqlite3_errstr(rc));
+    exit(EXIT_FAILURE);
+  }
+
+  rc = sqlite3_deserialize(db, "main", image, data->size, data->size,
+    SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE
+  );
+  if (rc != SQLITE_OK) {
+    printf_error("sqlite3_deserialize(); failed with error(%d): %s", rc, sqlite3_errmsg(db));
+    exit(EXIT_FAILURE);
+  }
+
+  printf_verbose(verbose, "Executing SQL script \"%s\"...", script_filename);
+
+  char *message = NULL;
+  rc = sqlite3_exec(db, script, NULL, NULL, &message);
+  if (rc != SQLITE_OK) {
+    printf_error("SQL script \"%s\" failed with error(%d): %s", script_filename, rc, message != NULL ? message : sqlite3_errstr(rc));
+    exit(EXIT_FAILURE);
+  }
+  printf_verbose(verbose, " Rows changed: %d", sqlite3_total_changes(db));
+
+  sqlite3_int64 serialized_size = 0;
+  byte *serialized = sqlite3_serialize(db, "main", &serialized_size, 0);
+  if (serialized == NULL) {
+    printf_error("sqlite3_serialize(); failed to serialize edited database");
+    exit(EXIT_FAILURE);
+  }
+  printf_verbose(verbose, "Serialized SQLite database size: %lld bytes", serialized_size);
+
+  /**
+   * Serialized copy belongs to SQLite, move it into the arena
+   */
+  ARENA_ALLOC_SIZE(arena, byte, edited, serialized_size, ARENA_UNINITIALIZED);
+  memcpy(edited, serialized, serialized_size);
+  sqlite3_free(serialized);
+  sqlite3_close(db);
+
+  data->value = edited;
+  data->size = (uint32_t) serialized_size;
+  property->length = data->size + UARRAYPROPERTY_ADDED_LENGTH;
+
+  compress(property, &reuse, jobify, compress_flags, arena, verbose);
+}
@@ -0,0 +1,86 @@
+#include "hash.h"
+
+static uint64_t read_le64(const byte *source) {
+  uint64_t value;
+  memcpy(&value, source, sizeof (value));
+  return value;
+}
+
+static uint32_t read_le32(const byte *source) {
+  uint32_t value;
+  memcpy(&value, source, sizeof (value));
+  return value;
+}
+
+static uint64_t rotl64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t xxh64_round(uint64_t accumulator, uint64_t input) {
+  accumulator += input * XXH_PRIME64_2;
+  accumulator = rotl64(accumulator, 31);
+  return accumulator * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge_round(uint64_t accumulator, uint64_t value) {
+  accumulator ^= xxh64_round(0, value);
+  return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/**
+ * Reference xxHash64, four independent lanes over 32 byte stripes
+ */
+uint64_t xxh64(const void *input, size_t length, uint64_t seed) {
+  const byte *source = (const byte *) input;
+  const byte *end = source + length;
+  uint64_t hash = 0;
+
+  if (length >= 32) {
+    uint64_t lanes[4] = {
+      seed + XXH_PRIME64_1 + XXH_PRIME64_2,
+      seed + XXH_PRIME64_2,
+      seed,
+      seed - XXH_PRIME64_1
+    };
+
+    for (; end - source >= 32; source += 32) {
+      lanes[0] = xxh64_round(lanes[0], read_le64(source));
+      lanes[1] = xxh64_round(lanes[1], read_le64(source + 8));
+      lanes[2] = xxh64_round(lanes[2], read_le64(source + 16));
+      lanes[3] = xxh64_round(lanes[3], read_le64(source + 24));
+    }
+
+    hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+    for (int i = 0; i < 4; i++) {
+      hash = xxh64_merge_round(hash, lanes[i]);
+    }
+  } else {
+    hash = seed + XXH_PRIME64_5;
+  }
+
+  hash += (uint64_t) length;
+
+  for (; end - source >= 8; source += 8) {
+    hash ^= xxh64_round(0, read_le64(source));
+    hash = rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+
+  if (end - source >= 4) {
+    hash ^= (uint64_t) read_le32(source) * XXH_PRIME64_1;
+    hash = rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    source += 4;
+  }
+
+  for (; source < end; source++) {
+    hash ^= (*source) * XXH_PRIME64_5;
+    hash = rotl64(hash, 11) * XXH_PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME64_3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
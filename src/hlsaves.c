@@ -1,4 +1,8 @@
 #include "oodle.h"
+#include "edit.h"
+#include "catalog.h"
+#include "manifest.h"
+#include "archive.h"
 
 static const byte needle[] = {
   0x11, 0x00, 0x00, 0x00, // length
@@ -13,7 +17,45 @@ const enum { needle_len = sizeof(needle) };
 void usage(const char *argv[]) {
   const char *basename = strrchr(argv[0], '\\');
   basename = basename != NULL ? basename + 1 : APPLICATION_IMAGE_NAME;
-  printf("Usage: %s [OPTION] input output [VERBOSE]\n [OPTION]\n  -d decompress converts new to old format\n  -c compress converts old to new format\n [VERBOSE]\n  -v prints additional info (optional)\n", basename);
+  printf("Usage: %s [OPTION] input output [SCRIPT] [VERBOSE] [--huge-pages] [--jobify=LEVEL] [--compact] [--manifest]\n"
+    "       %s -l index.csv input [input ...] [VERBOSE]\n"
+    "       %s -t input [input ...] [VERBOSE]\n"
+    "       %s -a archive input [input ...] [VERBOSE]\n"
+    "       %s -r archive version output [VERBOSE]\n"
+    " [OPTION]\n"
+    "  -d decompress converts new to old format\n"
+    "  -c compress converts old to new format\n"
+    "  -e edit runs SQL SCRIPT against the save database in memory\n"
+    "  -l catalog writes save metadata of every input to CSV index\n"
+    "  -t verify checks every input against its \"input.manifest\"\n"
+    "  -a archive stores every input as a new version in the deduplicating archive directory\n"
+    "  -r restore writes an archived version (1, 2, ... as listed in \"versions.csv\") to output\n"
+    " [VERBOSE]\n"
+    "  -v prints additional info (optional)\n"
+    " [--huge-pages]\n"
+    "  back large buffers with large pages (optional, needs \"Lock pages in memory\" privilege)\n"
+    " [--jobify=LEVEL]\n"
+    "  encoder parallelism inside a chunk: default, disable, normal or aggressive (optional)\n"
+    " [--compact]\n"
+    "  drop SQLite free pages before compressing (optional)\n"
+    " [--manifest]\n"
+    "  write block hashes of the output to \"output.manifest\" (optional)\n",
+    basename, basename, basename, basename, basename
+  );
+}
+
+/**
+ * Map jobify level name to its value, `OodleLZ_Jobify_Count` if unknown
+ */
+OodleLZ_Jobify parse_jobify(const char *level) {
+  static const char *levels[OodleLZ_Jobify_Count] = { "default", "disable", "normal", "aggressive" };
+  for (int i = 0; i < OodleLZ_Jobify_Count; i++) {
+    if (strcmp(levels[i], level) == 0) {
+      return (OodleLZ_Jobify) i;
+    }
+  }
+
+  return OodleLZ_Jobify_Count;
 }
 
 int main(const int argc, const char *argv[]) {
@@ -23,7 +65,7 @@ int main(const int argc, const char *argv[]) {
     "Report issues at https://github.com/topche-katt/hlsavetool/issues.\n\n"
   );
 
-  if (argc < 4) {
+  if (argc < 3) {
     usage(argv);
     exit(EXIT_FAILURE);
   }
@@ -31,6 +73,11 @@ int main(const int argc, const char *argv[]) {
   const char *command = argv[1];
   if (memcmp(command, COMMAND_DECOMPRESS, strlen(COMMAND_DECOMPRESS)) != 0
     && memcmp(command, COMMAND_COMPRESS, strlen(COMMAND_COMPRESS)) != 0
+    && memcmp(command, COMMAND_EDIT, strlen(COMMAND_EDIT)) != 0
+    && memcmp(command, COMMAND_CATALOG, strlen(COMMAND_CATALOG)) != 0
+    && memcmp(command, COMMAND_VERIFY, strlen(COMMAND_VERIFY)) != 0
+    && memcmp(command, COMMAND_ARCHIVE, strlen(COMMAND_ARCHIVE)) != 0
+    && memcmp(command, COMMAND_RESTORE, strlen(COMMAND_RESTORE)) != 0
   ) {
     printf_error("Unknown command \"%s\"", command);
     usage(argv);
@@ -39,6 +86,98 @@ int main(const int argc, const char *argv[]) {
 
   uint8_t command_decompress = memcmp(command, COMMAND_DECOMPRESS, strlen(COMMAND_DECOMPRESS));
   uint8_t command_compress = memcmp(command, COMMAND_COMPRESS, strlen(COMMAND_COMPRESS));
+  uint8_t command_edit = memcmp(command, COMMAND_EDIT, strlen(COMMAND_EDIT));
+  uint8_t command_catalog = memcmp(command, COMMAND_CATALOG, strlen(COMMAND_CATALOG));
+  uint8_t command_verify = memcmp(command, COMMAND_VERIFY, strlen(COMMAND_VERIFY));
+  uint8_t command_archive = memcmp(command, COMMAND_ARCHIVE, strlen(COMMAND_ARCHIVE));
+  uint8_t command_restore = memcmp(command, COMMAND_RESTORE, strlen(COMMAND_RESTORE));
+
+  /**
+   * Verify takes any number of inputs, each next to its manifest
+   */
+  if (command_verify == 0) {
+    bool verbose = strcmp(VERBOSITY_FLAG, argv[argc - 1]) == 0;
+    int count = argc - 2 - (verbose ? 1 : 0);
+    if (count < 1) {
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+
+    pool_init(0);
+    int result = verify(count, &argv[2], verbose);
+    pool_release();
+
+    return result;
+  }
+
+  if (argc < 4) {
+    usage(argv);
+    exit(EXIT_FAILURE);
+  }
+
+  /**
+   * Catalog takes any number of inputs and never reads them whole
+   */
+  if (command_catalog == 0) {
+    bool verbose = strcmp(VERBOSITY_FLAG, argv[argc - 1]) == 0;
+    int count = argc - 3 - (verbose ? 1 : 0);
+    if (count < 1) {
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+
+    pool_init(0);
+    int result = catalog(argv[2], count, &argv[3], verbose);
+    pool_release();
+
+    return result;
+  }
+
+  /**
+   * Archive takes any number of inputs, each becomes a new version
+   */
+  if (command_archive == 0) {
+    bool verbose = strcmp(VERBOSITY_FLAG, argv[argc - 1]) == 0;
+    int count = argc - 3 - (verbose ? 1 : 0);
+    if (count < 1) {
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+
+    pool_init(0);
+    int result = archive(argv[2], count, &argv[3], verbose);
+    pool_release();
+
+    return result;
+  }
+
+  /**
+   * Restore takes the version to write out
+   */
+  if (command_restore == 0) {
+    bool verbose = strcmp(VERBOSITY_FLAG, argv[argc - 1]) == 0;
+    if (argc - (verbose ? 1 : 0) != 5) {
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+
+    return restore(argv[2], argv[3], argv[4], verbose);
+  }
+
+  /**
+   * Edit takes the SQL script as an extra argument
+   */
+  int verbose_index = 4;
+  const char *script_filename = NULL;
+  if (command_edit == 0) {
+    if (argc < 5) {
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+
+    script_filename = argv[4];
+    verbose_index = 5;
+  }
 
   FILE *fpin = NULL;
   const char *input_filename = argv[2];
@@ -48,9 +187,46 @@ int main(const int argc, const char *argv[]) {
   const char *output_filename = argv[3];
   OPEN_FILE_WITH_ERROR_HANDLE(output_filename, "wb", fpout);
 
-  bool verbose = (argc == 5 && argv[4] != NULL) ? strcmp(VERBOSITY_FLAG, argv[4]) == 0 : false;
+  bool verbose = false;
+  bool huge_pages = false;
+  bool manifest = false;
+  OodleLZ_Jobify jobify = OodleLZ_Jobify_Default;
+  uint32_t compress_flags = 0;
+  for (int i = verbose_index; i < argc; i++) {
+    if (strcmp(VERBOSITY_FLAG, argv[i]) == 0) {
+      verbose = true;
+    } else if (strcmp(HUGE_PAGES_FLAG, argv[i]) == 0) {
+      huge_pages = true;
+    } else if (strncmp(JOBIFY_FLAG, argv[i], strlen(JOBIFY_FLAG)) == 0) {
+      jobify = parse_jobify(argv[i] + strlen(JOBIFY_FLAG));
+      if (jobify == OodleLZ_Jobify_Count) {
+        printf_error("Unknown jobify level \"%s\"", argv[i] + strlen(JOBIFY_FLAG));
+        usage(argv);
+        exit(EXIT_FAILURE);
+      }
+    } else if (strcmp(COMPACT_FLAG, argv[i]) == 0) {
+      compress_flags |= COMPRESS_COMPACT;
+    } else if (strcmp(MANIFEST_FLAG, argv[i]) == 0) {
+      manifest = true;
+    } else {
+      printf_error("Unknown option \"%s\"", argv[i]);
+      usage(argv);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  pool_init(0);
 
-  printf("Trying to %s save file \"%s\"\n", command_compress == 0 ? "compress" : "decompress", input_filename);
+  /**
+   * Everything allocated while processing the save lives in the arena
+   */
+  Arena *arena = arena_create(huge_pages);
+  if (huge_pages && !arena->huge_pages) {
+    printf_verbose(verbose, "Large pages are not available, \"Lock pages in memory\" privilege is required");
+  }
+
+  const char *action = command_compress == 0 ? "compress" : command_edit == 0 ? "edit" : "decompress";
+  printf("Trying to %s save file \"%s\"\n", action, input_filename);
 
   printf_verbose(verbose, "Input file: %s", input_filename);
   printf_verbose(verbose, "Output file: %s", output_filename);
@@ -64,7 +240,7 @@ int main(const int argc, const char *argv[]) {
   size_t buffer_size = sizeof (byte) * file_size;
   printf_verbose(verbose, "Input file memory buffer size: %llu bytes", buffer_size);
 
-  SAFE_ALLOC_SIZE(byte, buffer, buffer_size);
+  ARENA_ALLOC_SIZE(arena, byte, buffer, buffer_size, ARENA_UNINITIALIZED);
   const size_t read_size = fread(buffer, buffer_size, 1, fpin);
   if (read_size != 1 && (feof(fpin) || ferror(fpin))) {
     printf_error("Input file: %llu = fread(buffer, buffer_size, 1, fp); failed", read_size);
@@ -113,16 +289,16 @@ int main(const int argc, const char *argv[]) {
   printf_verbose(verbose, "Head address %llu and size %llu bytes", (uint64_t) head.address, head.size);
   printf_verbose(verbose, "Head relative offset: %llu", address - buffer);
 
-  SAFE_ALLOC(UProperty, property);
+  ARENA_ALLOC(arena, UProperty, property);
 
-  READ_FSTRING(property->name, address);
+  READ_FSTRING(arena, property->name, address);
   PRINT_FSTRING(property->name);
   if (memcmp(property->name.data, RDI_UPROPERTY_NAME, RDI_UPROPERTY_NAME_LEN) != 0) {
     printf_error("Expected UProperty with name \"%s\" got \"%s\"", RDI_UPROPERTY_NAME, (byte *) property->name.data);
     exit(EXIT_FAILURE);
   }
 
-  READ_FSTRING(property->type, address);
+  READ_FSTRING(arena, property->type, address);
   PRINT_FSTRING(property->type);
   if (memcmp(property->type.data, RDI_UPROPERTY_TYPE, RDI_UPROPERTY_TYPE_LEN) != 0) {
     printf_error("Expected UProperty of type \"%s\" got \"%s\"", RDI_UPROPERTY_TYPE, (byte *) property->type.data);
@@ -132,9 +308,9 @@ int main(const int argc, const char *argv[]) {
   COPY_MEMORY(address, &property->length, sizeof (property->length));
   printf_verbose(verbose, "ArrayProperty value length: %llu bytes", property->length);
 
-  SAFE_ALLOC(UArrayProperty, value);
+  ARENA_ALLOC(arena, UArrayProperty, value);
 
-  READ_FSTRING(value->type, address);
+  READ_FSTRING(arena, value->type, address);
   PRINT_FSTRING(value->type);
   if (memcmp(value->type.data, RDI_UPROPERTY_VALUE_TYPE, RDI_UPROPERTY_VALUE_TYPE_LEN) != 0) {
     printf_error("Expected UProperty data of type \"%s\" got \"%s\"", RDI_UPROPERTY_VALUE_TYPE, (byte *) value->type.data);
@@ -145,9 +321,10 @@ int main(const int argc, const char *argv[]) {
   COPY_MEMORY(address, &value->size, sizeof (value->size));
   printf_verbose(verbose, "ByteProperty value length: %lu bytes", value->size);
 
-  size_t size = sizeof (byte) * value->size;
-  SAFE_ALLOC_SIZE(byte, data, size);
-  COPY_MEMORY(address, data, size);
+  /**
+   * Value is not copied, input buffer lives as long as the arena
+   */
+  byte *data = address;
   value->value = data;
   property->data = value;
 
@@ -165,11 +342,15 @@ int main(const int argc, const char *argv[]) {
   printf_verbose(verbose, "Before processing %s with %s command", (byte *) property->name.data, command);
 
   if (command_decompress == 0) {
-    decompress(property, verbose);
+    decompress(property, arena, verbose);
   }
 
   if (command_compress == 0) {
-    compress(property, verbose);
+    compress(property, NULL, jobify, compress_flags, arena, verbose);
+  }
+
+  if (command_edit == 0) {
+    edit(property, script_filename, jobify, compress_flags, arena, verbose);
   }
 
   printf_verbose(verbose, "Begin writing to output file: %s", output_filename);
@@ -180,15 +361,29 @@ int main(const int argc, const char *argv[]) {
 
   printf_verbose(verbose, "Finished writing to output file: %s", output_filename);
 
+  uint64_t output_size = ftell(fpout);
   fclose(fpout);
   fclose(fpin);
 
-  free(buffer);
-  free(value->value);
-  free(value);
-  free(property);
+  if (manifest) {
+    UArrayProperty *output_value = (UArrayProperty *) property->data;
+    SaveLayout layout = {
+      .head = head,
+      .stream = { .address = output_value->value, .size = output_value->size },
+      .tail = tail,
+      .file_size = output_size
+    };
+
+    if (write_manifest(output_filename, &layout, arena, verbose) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf_verbose(verbose, "Released %llu bytes of arena memory", arena->allocated);
+  arena_release(arena);
+  pool_release();
 
-  printf("Successfully %s to save file \"%s\"\n", command_compress == 0 ? "compressed" : "decompressed", output_filename);
+  printf("Successfully %sed to save file \"%s\"\n", action, output_filename);
 
   return EXIT_SUCCESS;
 }
@@ -210,6 +405,23 @@ void *memmem(const void *haystack, size_t haystack_len, const void *needle, cons
   return NULL;
 }
 
+/**
+ * Quick pread() implementation on top of overlapped ReadFile()
+ */
+int64_t pread(HANDLE file, void *buffer, size_t count, uint64_t offset) {
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof (overlapped));
+  overlapped.Offset = (DWORD) (offset & 0xFFFFFFFFu);
+  overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+  DWORD read_size = 0;
+  if (!ReadFile(file, buffer, (DWORD) count, &read_size, &overlapped)) {
+    return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+  }
+
+  return read_size;
+}
+
 /**
  * Print error message wrapper
  */
@@ -0,0 +1,208 @@
+#include "kraken.h"
+
+#if defined(_M_X64)
+  #include <intrin.h>
+  #include <immintrin.h>
+#endif
+
+static KrakenFill_FP *Kraken_Fill = NULL;
+static KrakenRepeats_FP *Kraken_Repeats = NULL;
+static const char *Kraken_Kernels = NULL;
+
+/**
+ * Scalar kernels, eight bytes at a time
+ */
+static void fill_scalar(byte *destination, byte value, size_t size) {
+  uint64_t pattern = 0x0101010101010101ull * value;
+  for (; size >= sizeof (pattern); size -= sizeof (pattern), destination += sizeof (pattern)) {
+    memcpy(destination, &pattern, sizeof (pattern));
+  }
+  for (; size > 0; size--) {
+    *destination++ = value;
+  }
+}
+
+static bool repeats_scalar(const byte *source, byte value, size_t size) {
+  uint64_t pattern = 0x0101010101010101ull * value;
+  uint64_t difference = 0;
+  for (; size >= sizeof (pattern); size -= sizeof (pattern), source += sizeof (pattern)) {
+    uint64_t word;
+    memcpy(&word, source, sizeof (word));
+    difference |= word ^ pattern;
+  }
+  for (; size > 0; size--) {
+    difference |= *source++ ^ value;
+  }
+
+  return difference == 0;
+}
+
+#if defined(_M_X64)
+/**
+ * SSE2 kernels, always available on x64
+ */
+static void fill_sse2(byte *destination, byte value, size_t size) {
+  __m128i pattern = _mm_set1_epi8((char) value);
+  for (; size >= sizeof (pattern) * 4; size -= sizeof (pattern) * 4, destination += sizeof (pattern) * 4) {
+    _mm_storeu_si128((__m128i *) destination, pattern);
+    _mm_storeu_si128((__m128i *) destination + 1, pattern);
+    _mm_storeu_si128((__m128i *) destination + 2, pattern);
+    _mm_storeu_si128((__m128i *) destination + 3, pattern);
+  }
+  for (; size >= sizeof (pattern); size -= sizeof (pattern), destination += sizeof (pattern)) {
+    _mm_storeu_si128((__m128i *) destination, pattern);
+  }
+  fill_scalar(destination, value, size);
+}
+
+static bool repeats_sse2(const byte *source, byte value, size_t size) {
+  __m128i pattern = _mm_set1_epi8((char) value);
+  for (; size >= sizeof (pattern) * 4; size -= sizeof (pattern) * 4, source += sizeof (pattern) * 4) {
+    __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) source), pattern);
+    __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) source + 1), pattern);
+    __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) source + 2), pattern);
+    __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) source + 3), pattern);
+    if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))) != 0xFFFF) {
+      return false;
+    }
+  }
+
+  return repeats_scalar(source, value, size);
+}
+
+/**
+ * AVX2 kernels, only picked when both CPU and OS support AVX2
+ */
+static void fill_avx2(byte *destination, byte value, size_t size) {
+  __m256i pattern = _mm256_set1_epi8((char) value);
+  for (; size >= sizeof (pattern) * 4; size -= sizeof (pattern) * 4, destination += sizeof (pattern) * 4) {
+    _mm256_storeu_si256((__m256i *) destination, pattern);
+    _mm256_storeu_si256((__m256i *) destination + 1, pattern);
+    _mm256_storeu_si256((__m256i *) destination + 2, pattern);
+    _mm256_storeu_si256((__m256i *) destination + 3, pattern);
+  }
+  for (; size >= sizeof (pattern); size -= sizeof (pattern), destination += sizeof (pattern)) {
+    _mm256_storeu_si256((__m256i *) destination, pattern);
+  }
+  fill_sse2(destination, value, size);
+}
+
+static bool repeats_avx2(const byte *source, byte value, size_t size) {
+  __m256i pattern = _mm256_set1_epi8((char) value);
+  bool repeats = true;
+  for (; repeats && size >= sizeof (pattern) * 4; size -= sizeof (pattern) * 4, source += sizeof (pattern) * 4) {
+    __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) source), pattern);
+    __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) source + 1), pattern);
+    __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) source + 2), pattern);
+    __m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) source + 3), pattern);
+    repeats = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, d))) == -1;
+  }
+  _mm256_zeroupper();
+
+  return repeats && repeats_sse2(source, value, size);
+}
+
+/**
+ * AVX2 needs CPUID.7:EBX[5] and the OS saving YMM state (XCR0 bits 1 and 2)
+ */
+static bool cpu_supports_avx2() {
+  int info[4] = { 0 };
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+}
+#endif
+
+/**
+ * Pick kernels for this CPU, returns their name
+ */
+const char *kraken_init() {
+  if (Kraken_Kernels != NULL) {
+    return Kraken_Kernels;
+  }
+
+  Kraken_Fill = fill_scalar;
+  Kraken_Repeats = repeats_scalar;
+  Kraken_Kernels = "scalar";
+
+#if defined(_M_X64)
+  Kraken_Fill = fill_sse2;
+  Kraken_Repeats = repeats_sse2;
+  Kraken_Kernels = "sse2";
+
+  if (cpu_supports_avx2()) {
+    Kraken_Fill = fill_avx2;
+    Kraken_Repeats = repeats_avx2;
+    Kraken_Kernels = "avx2";
+  }
+#endif
+
+  return Kraken_Kernels;
+}
+
+void kraken_fill(byte *destination, byte value, size_t size) {
+  Kraken_Fill(destination, value, size);
+}
+
+/**
+ * Whether `source` is a single byte repeated, the byte goes to `value`
+ */
+bool kraken_repeat_scan(const byte *source, size_t size, byte *value) {
+  if (size == 0) {
+    return false;
+  }
+
+  *value = source[0];
+  return Kraken_Repeats(source, *value, size);
+}
+
+/**
+ * Known compressed forms of a single byte repeated over one quantum:
+ * block header, memset quantum header and the fill byte
+ */
+static const byte Kraken_Memset_Forms[][KRAKEN_MEMSET_FORM_SIZE - 1] = {
+  { 0x8C, 0x06, 0x07, 0xFF, 0xFF },
+  { 0x0C, 0x06, 0x07, 0xFF, 0xFF },
+  { 0x8C, 0x86, 0x07, 0xFF, 0xFF },
+  { 0x0C, 0x86, 0x07, 0xFF, 0xFF }
+};
+
+/**
+ * Write the compressed form of `value` repeated over a whole block
+ * of up to `KRAKEN_QUANTUM_SIZE` bytes, returns its size
+ */
+size_t kraken_encode_memset(byte value, byte *destination) {
+  memcpy(destination, Kraken_Memset_Forms[0], KRAKEN_MEMSET_FORM_SIZE - 1);
+  destination[KRAKEN_MEMSET_FORM_SIZE - 1] = value;
+
+  return KRAKEN_MEMSET_FORM_SIZE;
+}
+
+/**
+ * Whether compressed block is one of the known memset forms
+ */
+bool kraken_memset_form(const byte *source, size_t source_size, size_t destination_size, byte *value) {
+  if (source_size != KRAKEN_MEMSET_FORM_SIZE || destination_size == 0 || destination_size > KRAKEN_QUANTUM_SIZE) {
+    return false;
+  }
+
+  for (size_t i = 0; i < sizeof (Kraken_Memset_Forms) / sizeof (Kraken_Memset_Forms[0]); i++) {
+    if (memcmp(source, Kraken_Memset_Forms[i], KRAKEN_MEMSET_FORM_SIZE - 1) == 0) {
+      *value = source[KRAKEN_MEMSET_FORM_SIZE - 1];
+      return true;
+    }
+  }
+
+  return false;
+}
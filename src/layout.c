@@ -0,0 +1,160 @@
+#include "layout.h"
+
+/**
+ * Read the whole file into the arena, NULL on failure
+ */
+byte *read_file(const char *filename, size_t *size, Arena *arena) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    printf_error("fopen(\"%s\"); failed with error(%d): %s", filename, errno, strerror(errno));
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  ARENA_ALLOC_SIZE(arena, byte, buffer, *size > 0 ? *size : 1, ARENA_UNINITIALIZED);
+  size_t read_size = *size > 0 ? fread(buffer, *size, 1, fp) : 1;
+  fclose(fp);
+
+  if (read_size != 1) {
+    printf_error("Reading \"%s\" failed", filename);
+    return NULL;
+  }
+
+  return buffer;
+}
+
+/**
+ * Write CSV field, quoted with embedded quotes doubled
+ */
+void csv_string(FILE *fp, const char *value) {
+  fputc('"', fp);
+  for (const char *chr = value; *chr != '\0'; chr++) {
+    if (*chr == '"') {
+      fputc('"', fp);
+    }
+    fputc(*chr, fp);
+  }
+  fputc('"', fp);
+}
+
+static bool skip_fstring(const byte **cursor, const byte *end) {
+  uint32_t length = 0;
+  if (end - *cursor < (ptrdiff_t) sizeof (length)) {
+    return false;
+  }
+
+  memcpy(&length, *cursor, sizeof (length));
+  *cursor += sizeof (length);
+  if ((size_t) (end - *cursor) < length) {
+    return false;
+  }
+
+  *cursor += length;
+  return true;
+}
+
+/**
+ * Split save buffer the same way `main()` does:
+ * head, `RawDatabaseImage` value and tail
+ */
+bool locate_layout(byte *buffer, size_t size, SaveLayout *layout) {
+  byte needle[sizeof (uint32_t) + RDI_UPROPERTY_NAME_LEN];
+  uint32_t needle_length = RDI_UPROPERTY_NAME_LEN;
+  memcpy(needle, &needle_length, sizeof (needle_length));
+  memcpy(needle + sizeof (needle_length), RDI_UPROPERTY_NAME, RDI_UPROPERTY_NAME_LEN);
+
+  byte *memory = buffer;
+  size_t memory_size = size;
+  byte *address = NULL;
+  SEARCH_MEMORY(address, memory, memory_size, needle, sizeof (needle));
+  if (address == NULL) {
+    return false;
+  }
+
+  const byte *end = buffer + size;
+  const byte *cursor = address + sizeof (needle);
+  uint32_t value_size = 0;
+  if (!skip_fstring(&cursor, end)
+    || end - cursor < (ptrdiff_t) sizeof (uint64_t)
+  ) {
+    return false;
+  }
+
+  cursor += sizeof (uint64_t);
+  if (!skip_fstring(&cursor, end) || end - cursor < (ptrdiff_t) (sizeof (uint8_t) + sizeof (value_size))) {
+    return false;
+  }
+
+  cursor += sizeof (uint8_t);
+  memcpy(&value_size, cursor, sizeof (value_size));
+  cursor += sizeof (value_size);
+
+  /**
+   * Truncated saves keep what is left of the stream,
+   * so the damaged blocks can be reported
+   */
+  if ((size_t) (end - cursor) < value_size) {
+    value_size = (uint32_t) (end - cursor);
+  }
+
+  layout->file_size = size;
+  layout->head.address = buffer;
+  layout->head.size = address - buffer;
+  layout->stream.address = (byte *) cursor;
+  layout->stream.size = value_size;
+  layout->tail.address = (byte *) cursor + value_size;
+  layout->tail.size = end - (cursor + value_size);
+
+  return true;
+}
+
+bool stream_compressed(const MemoryAddress *stream) {
+  uint32_t signature = 0;
+  if (stream->size >= sizeof (signature)) {
+    memcpy(&signature, stream->address, sizeof (signature));
+  }
+
+  return signature == OODLE_COMPRESSED_BLOCK_SIGNATURE;
+}
+
+/**
+ * Split stream into blocks (only counted if `blocks` is NULL),
+ * returns the block count or 0 if `UpkOodle` headers do not add up
+ */
+size_t split_stream(const MemoryAddress *stream, bool compressed, StreamBlock *blocks) {
+  size_t count = 0;
+  for (size_t offset = 0; offset < stream->size; count++) {
+    size_t size = stream->size - offset;
+    uint64_t uncompressed_size = 0;
+
+    if (compressed) {
+      UpkOodle upk;
+      if (size < sizeof (upk)) {
+        return 0;
+      }
+
+      memcpy(&upk, stream->address + offset, sizeof (upk));
+      if (upk.signature != OODLE_COMPRESSED_BLOCK_SIGNATURE || upk.blocks[0].compressed_size > size - sizeof (upk)) {
+        return 0;
+      }
+
+      size = sizeof (upk) + upk.blocks[0].compressed_size;
+      uncompressed_size = upk.blocks[0].uncompressed_size;
+    } else {
+      size = size > OODLE_MAX_BLOCK_SIZE ? OODLE_MAX_BLOCK_SIZE : size;
+      uncompressed_size = size;
+    }
+
+    if (blocks != NULL) {
+      blocks[count].offset = offset;
+      blocks[count].size = size;
+      blocks[count].uncompressed_size = uncompressed_size;
+    }
+    offset += size;
+  }
+
+  return count;
+}
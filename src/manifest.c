@@ -0,0 +1,257 @@
+#include "manifest.h"
+
+/**
+ * Hash of a single range of the save, one pool task each
+ */
+typedef struct _HASH_JOB {
+  const byte *address;
+  size_t size;
+  uint64_t hash;
+  PoolTask *task;
+} HashJob;
+
+static void hash_task(void *argument) {
+  HashJob *job = (HashJob *) argument;
+  job->hash = xxh64(job->address, job->size, MANIFEST_HASH_SEED);
+}
+
+/**
+ * Hash every range in parallel, `group` keeps the wait
+ * from running tasks other than these hashes
+ */
+static void hash_ranges(HashJob *jobs, size_t count, const void *group) {
+  for (size_t i = 0; i < count; i++) {
+    jobs[i].task = pool_submit_after(hash_task, &jobs[i], group, NULL, 0);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    pool_wait_group(jobs[i].task, group);
+  }
+}
+
+/**
+ * Single save being verified on its own pool task
+ */
+typedef struct _VERIFY_JOB {
+  const char *filename;
+  uint32_t problems;
+  bool verbose;
+} VerifyJob;
+
+static char *manifest_filename(const char *save_filename, Arena *arena) {
+  size_t length = strlen(save_filename);
+  ARENA_ALLOC_SIZE(arena, char, filename, length + sizeof (MANIFEST_EXTENSION), ARENA_UNINITIALIZED);
+  memcpy(filename, save_filename, length);
+  memcpy(filename + length, MANIFEST_EXTENSION, sizeof (MANIFEST_EXTENSION));
+
+  return filename;
+}
+
+/**
+ * Hash head, tail and every block of the stream and write `<save>.manifest`
+ */
+int write_manifest(const char *save_filename, const SaveLayout *layout, Arena *arena, bool verbose) {
+  bool compressed = stream_compressed(&layout->stream);
+  size_t block_count = split_stream(&layout->stream, compressed, NULL);
+  if (block_count == 0) {
+    printf_error("Can not split %llu bytes of RawDatabaseImage into blocks", layout->stream.size);
+    return EXIT_FAILURE;
+  }
+
+  ARENA_ALLOC_SIZE(arena, StreamBlock, stream_blocks, sizeof (StreamBlock) * block_count, ARENA_ZEROED);
+  split_stream(&layout->stream, compressed, stream_blocks);
+
+  ARENA_ALLOC_SIZE(arena, ManifestBlock, blocks, sizeof (ManifestBlock) * block_count, ARENA_ZEROED);
+  for (size_t i = 0; i < block_count; i++) {
+    blocks[i].offset = stream_blocks[i].offset;
+    blocks[i].size = stream_blocks[i].size;
+    blocks[i].uncompressed_size = stream_blocks[i].uncompressed_size;
+  }
+
+  /**
+   * Head and tail go first, blocks follow
+   */
+  ARENA_ALLOC_SIZE(arena, HashJob, jobs, sizeof (HashJob) * (block_count + 2), ARENA_ZEROED);
+  jobs[0].address = layout->head.address;
+  jobs[0].size = layout->head.size;
+  jobs[1].address = layout->tail.address;
+  jobs[1].size = layout->tail.size;
+  for (size_t i = 0; i < block_count; i++) {
+    jobs[i + 2].address = layout->stream.address + blocks[i].offset;
+    jobs[i + 2].size = blocks[i].size;
+  }
+  hash_ranges(jobs, block_count + 2, jobs);
+
+  ManifestHeader header;
+  memset(&header, 0, sizeof (header));
+  header.signature = MANIFEST_SIGNATURE;
+  header.version = MANIFEST_VERSION;
+  header.compressed = compressed;
+  header.block_count = (uint32_t) block_count;
+  header.file_size = layout->file_size;
+  header.head_size = layout->head.size;
+  header.head_hash = jobs[0].hash;
+  header.stream_size = layout->stream.size;
+  header.tail_size = layout->tail.size;
+  header.tail_hash = jobs[1].hash;
+  for (size_t i = 0; i < block_count; i++) {
+    blocks[i].hash = jobs[i + 2].hash;
+  }
+
+  char *filename = manifest_filename(save_filename, arena);
+  FILE *fp = NULL;
+  OPEN_FILE_WITH_ERROR_HANDLE(filename, "wb", fp);
+  WRITE_FILE_WITH_ERROR_HANDLE(fp, &header, sizeof (header), 1);
+  WRITE_FILE_WITH_ERROR_HANDLE(fp, blocks, sizeof (ManifestBlock), block_count);
+  fclose(fp);
+
+  printf_verbose(verbose, "Manifest \"%s\" lists %llu %s blocks", filename, block_count, compressed ? "compressed" : "raw");
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Check a single save against its manifest, returns number of problems
+ */
+static uint32_t verify_file(const char *save_filename, Arena *arena, bool verbose) {
+  char *filename = manifest_filename(save_filename, arena);
+
+  size_t manifest_size = 0;
+  byte *manifest = read_file(filename, &manifest_size, arena);
+  if (manifest == NULL) {
+    return 1;
+  }
+
+  ManifestHeader header;
+  memset(&header, 0, sizeof (header));
+  if (manifest_size >= sizeof (header)) {
+    memcpy(&header, manifest, sizeof (header));
+  }
+
+  if (header.signature != MANIFEST_SIGNATURE || header.version != MANIFEST_VERSION
+    || manifest_size != sizeof (header) + (size_t) header.block_count * sizeof (ManifestBlock)
+  ) {
+    printf_error("Manifest \"%s\" is malformed", filename);
+    return 1;
+  }
+  ManifestBlock *blocks = (ManifestBlock *) (manifest + sizeof (header));
+
+  size_t save_size = 0;
+  byte *save = read_file(save_filename, &save_size, arena);
+  if (save == NULL) {
+    return 1;
+  }
+
+  SaveLayout layout;
+  if (!locate_layout(save, save_size, &layout)) {
+    printf_error("%s: could not locate \"RawDatabaseImage\" UProperty", save_filename);
+    return 1;
+  }
+
+  uint32_t problems = 0;
+  if (layout.file_size != header.file_size || layout.head.size != header.head_size
+    || layout.stream.size != header.stream_size || layout.tail.size != header.tail_size
+  ) {
+    printf_error("%s: size %llu (head %llu, stream %llu, tail %llu) does not match manifest %llu (head %llu, stream %llu, tail %llu)",
+      save_filename, layout.file_size, layout.head.size, layout.stream.size, layout.tail.size,
+      header.file_size, header.head_size, header.stream_size, header.tail_size
+    );
+    problems++;
+  }
+
+  /**
+   * Hash the ranges the manifest lists, ranges past the end are truncated
+   */
+  ARENA_ALLOC_SIZE(arena, HashJob, jobs, sizeof (HashJob) * ((size_t) header.block_count + 2), ARENA_ZEROED);
+  size_t job_count = 2;
+  jobs[0].address = layout.head.address;
+  jobs[0].size = layout.head.size;
+  jobs[1].address = layout.tail.address;
+  jobs[1].size = layout.tail.size;
+
+  uint64_t covered = 0;
+  for (uint32_t i = 0; i < header.block_count; i++) {
+    if (blocks[i].offset != covered || blocks[i].offset > layout.stream.size
+      || blocks[i].size > layout.stream.size - blocks[i].offset
+    ) {
+      printf_error("%s: block #%u at offset %llu of %llu bytes is truncated or out of place", save_filename, i, blocks[i].offset, blocks[i].size);
+      problems++;
+      break;
+    }
+
+    jobs[job_count].address = layout.stream.address + blocks[i].offset;
+    jobs[job_count].size = blocks[i].size;
+    job_count++;
+    covered += blocks[i].size;
+  }
+  hash_ranges(jobs, job_count, jobs);
+
+  if (jobs[0].hash != header.head_hash) {
+    printf_error("%s: head hash mismatch", save_filename);
+    problems++;
+  }
+
+  if (jobs[1].hash != header.tail_hash) {
+    printf_error("%s: tail hash mismatch", save_filename);
+    problems++;
+  }
+
+  for (size_t i = 2; i < job_count; i++) {
+    if (jobs[i].hash != blocks[i - 2].hash) {
+      printf_error("%s: block #%llu at offset %llu hash mismatch", save_filename, i - 2, blocks[i - 2].offset);
+      problems++;
+    }
+  }
+
+  printf_verbose(verbose, "%s: hashed %llu of %lu %s blocks", save_filename, job_count - 2, header.block_count, header.compressed ? "compressed" : "raw");
+
+  return problems;
+}
+
+static void verify_task(void *argument) {
+  VerifyJob *job = (VerifyJob *) argument;
+  Arena *arena = arena_create(false);
+  job->problems = verify_file(job->filename, arena, job->verbose);
+  arena_release(arena);
+}
+
+/**
+ * Verify every save against its `<save>.manifest`, each save is read
+ * and hashed on its own pool task, a window of them in flight at once,
+ * results are reported in input order
+ */
+int verify(int count, const char *filenames[], bool verbose) {
+  SAFE_ALLOC_SIZE(VerifyJob, jobs, sizeof (VerifyJob) * count);
+  SAFE_ALLOC_SIZE(PoolTask *, tasks, sizeof (PoolTask *) * count);
+
+  int window = (int) pool_size() * 2;
+  window = window > 0 ? window : 1;
+  printf_verbose(verbose, "Verifying with %u worker thread(s), %d save(s) in flight", pool_size(), window);
+
+  for (int i = 0; i < count; i++) {
+    jobs[i].filename = filenames[i];
+    jobs[i].verbose = verbose;
+  }
+
+  for (int i = 0; i < count && i < window; i++) {
+    tasks[i] = pool_submit(verify_task, &jobs[i]);
+  }
+
+  uint32_t failed = 0;
+  for (int i = 0; i < count; i++) {
+    pool_wait(tasks[i]);
+    if (i + window < count) {
+      tasks[i + window] = pool_submit(verify_task, &jobs[i + window]);
+    }
+
+    printf("%s: %s\n", filenames[i], jobs[i].problems == 0 ? "OK" : "FAILED");
+    failed += jobs[i].problems != 0;
+  }
+
+  free(tasks);
+  free(jobs);
+
+  printf("Verified %d save file(s), %u failed\n", count, failed);
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -10,6 +10,99 @@ static OodleLZ_Compress_FP *OodleLZ_Compress = NULL;
 static OodleLZ_Decompress_FP *OodleLZ_Decompress = NULL;
 static OodleLZ_GetCompressedBufferSizeNeeded_FP *OodleLZ_Size_Needed = NULL;
 static OodleLZ_CompressOptions_GetDefault_FP *OodleLZ_Compress_Options = NULL;
+static OodleLZDecoder_MemorySizeNeeded_FP *OodleLZDecoder_Memory_Needed = NULL;
+static OodleLZ_ThreadPhased_BlockDecoderMemorySizeNeeded_FP *OodleLZ_Phased_Memory_Needed = NULL;
+static OodleCore_Plugins_SetJobSystemAndCount_FP *OodleCore_Set_Job_System = NULL;
+
+/**
+ * Single compressed block as seen by the decode scheduler,
+ * scratch is the decoder memory shared by both decode phases
+ */
+#define DECODE_SCRATCH_SLOTS 2
+
+typedef struct _DECODE_JOB {
+  byte *compressed;
+  size_t compressed_size;
+  byte *output;
+  size_t uncompressed_size;
+  byte *scratch;
+  size_t scratch_size;
+  int phase1_result;
+} DecodeJob;
+
+/**
+ * Handed to the encoder as `jobifyUserPtr` of a single chunk,
+ * jobs it spawns form a pool group and counts them
+ */
+typedef struct _JOBIFY_CONTEXT {
+  volatile LONG jobs;
+} JobifyContext;
+
+/**
+ * Single raw chunk as seen by the encoder, either compressed
+ * into `output` on the pool or copied verbatim from `reused`
+ */
+typedef struct _ENCODE_JOB {
+  byte *raw;
+  size_t raw_size;
+  byte *output;
+  int compressed_size;
+  const byte *reused;
+  size_t reused_size;
+  OodleLZ_CompressOptions options;
+  JobifyContext jobify;
+  PoolTask *task;
+} EncodeJob;
+
+/**
+ * Oodle job function along with its data
+ */
+typedef struct _OODLE_JOB {
+  Oodle_Job_FP *function;
+  void *data;
+} OodleJob;
+
+static void oodle_job_task(void *argument) {
+  OodleJob *job = (OodleJob *) argument;
+  job->function(job->data);
+  free(job);
+}
+
+/**
+ * Oodle job system plugin, jobs run on the shared pool,
+ * handles are pool tasks and are never zero.
+ *
+ * NOTE: Jobs are queued once their dependencies are done, nobody
+ * blocks inside this callback. Jobs of a chunk share the chunk's
+ * `JobifyContext` as their pool group and waiting for one only helps
+ * with jobs of the same chunk, so the encoder is never re-entered
+ * for another chunk on the waiting stack.
+ */
+static uint64_t WINAPI oodle_run_job(Oodle_Job_FP *fp_job, void *job_data, uint64_t *dependencies, int num_dependencies, void *user_ptr) {
+  SAFE_ALLOC(OodleJob, job);
+  job->function = fp_job;
+  job->data = job_data;
+
+  if (user_ptr != NULL) {
+    InterlockedIncrement(&((JobifyContext *) user_ptr)->jobs);
+  }
+
+  PoolTask *waits[OODLE_JOB_MAX_DEPENDENCIES];
+  if (num_dependencies > OODLE_JOB_MAX_DEPENDENCIES) {
+    printf_error("Oodle job has %d dependencies, at most %d are supported", num_dependencies, OODLE_JOB_MAX_DEPENDENCIES);
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < num_dependencies; i++) {
+    waits[i] = (PoolTask *) (uintptr_t) dependencies[i];
+  }
+
+  return (uint64_t) (uintptr_t) pool_submit_after(oodle_job_task, job, user_ptr, waits, num_dependencies);
+}
+
+static void WINAPI oodle_wait_job(uint64_t job_handle, void *user_ptr) {
+  pool_wait_group((PoolTask *) (uintptr_t) job_handle, user_ptr);
+}
 
 /**
  * Load dll and obtain function pointers or die a quick death...
@@ -25,6 +118,11 @@ void InitOodleLibrary() {
   GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleLZ_Decompress, OodleLZ_Decompress_FP, "OodleLZ_Decompress");
   GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleLZ_Size_Needed, OodleLZ_GetCompressedBufferSizeNeeded_FP, "OodleLZ_GetCompressedBufferSizeNeeded");
   GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleLZ_Compress_Options, OodleLZ_CompressOptions_GetDefault_FP, "OodleLZ_CompressOptions_GetDefault");
+  GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleLZDecoder_Memory_Needed, OodleLZDecoder_MemorySizeNeeded_FP, "OodleLZDecoder_MemorySizeNeeded");
+  GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleLZ_Phased_Memory_Needed, OodleLZ_ThreadPhased_BlockDecoderMemorySizeNeeded_FP, "OodleLZ_ThreadPhased_BlockDecoderMemorySizeNeeded");
+  GET_PROCEDURE_ADDRESS(Oodle_Handle, OodleCore_Set_Job_System, OodleCore_Plugins_SetJobSystemAndCount_FP, "OodleCore_Plugins_SetJobSystemAndCount");
+
+  OodleCore_Set_Job_System(oodle_run_job, oodle_wait_job, pool_size() > 0 ? (int) pool_size() : 1);
 }
 
 void releaseOodleLibrary() {
@@ -36,14 +134,58 @@ void releaseOodleLibrary() {
   OodleLZ_Decompress = NULL;
   OodleLZ_Size_Needed = NULL;
   OodleLZ_Compress_Options = NULL;
+  OodleLZDecoder_Memory_Needed = NULL;
+  OodleLZ_Phased_Memory_Needed = NULL;
+  OodleCore_Set_Job_System = NULL;
+}
+
+/**
+ * Compare a raw chunk against the same range of the previous raw stream,
+ * which is the `UpkOodleSqliteSize` prefix followed by the SQLite image
+ */
+static bool reuse_matches(const UpkReuse *reuse, size_t raw_offset, const byte *chunk, size_t chunk_size) {
+  UpkOodleSqliteSize prefix = { (uint32_t) reuse->sqlite.size + SQLITE_UPK_HEADER_ADDED_LENGTH, (uint32_t) reuse->sqlite.size };
+  if (raw_offset + chunk_size > sizeof (prefix) + reuse->sqlite.size) {
+    return false;
+  }
+
+  if (raw_offset < sizeof (prefix)) {
+    size_t prefix_size = sizeof (prefix) - raw_offset;
+    if (prefix_size > chunk_size) {
+      prefix_size = chunk_size;
+    }
+    if (memcmp((byte *) &prefix + raw_offset, chunk, prefix_size) != 0) {
+      return false;
+    }
+
+    chunk += prefix_size;
+    chunk_size -= prefix_size;
+    raw_offset += prefix_size;
+  }
+
+  return memcmp(reuse->sqlite.address + raw_offset - sizeof (prefix), chunk, chunk_size) == 0;
 }
 
-void compress(UProperty *property, bool verbose) {
+static void encode_task(void *argument) {
+  EncodeJob *job = (EncodeJob *) argument;
+  job->compressed_size = OodleLZ_Compress(OodleLZ_Compressor_Kraken, job->raw, job->raw_size, job->output,
+    OodleLZ_CompressionLevel_Fast, &job->options, NULL, NULL, NULL, 0
+  );
+}
+
+void compress(UProperty *property, const UpkReuse *reuse, OodleLZ_Jobify jobify, uint32_t flags, Arena *arena, bool verbose) {
   UArrayProperty *data = (UArrayProperty *) property->data;
 
   printf_verbose(verbose, "Compressing %lu bytes of data...", data->size);
   InitOodleLibrary();
 
+  /**
+   * Free pages would be compressed as-is, drop them first
+   */
+  if (flags & COMPRESS_COMPACT) {
+    data->size = (uint32_t) compact(data->value, data->size, arena, verbose);
+  }
+
   byte *tmp_data = data->value;
 
   /**
@@ -70,46 +212,62 @@ void compress(UProperty *property, bool verbose) {
 
   UpkOodleSqliteSize upk_sqlite_size = { sqlite_size + SQLITE_UPK_HEADER_ADDED_LENGTH, sqlite_size };
 
-  /**
-   * Output size should be less than input size,
-   * just allocate uncompressed size of bytes
-   */
-  size_t result_size = 0;
-  SAFE_ALLOC_SIZE(byte, result_data, sizeof (byte) * data->size);
-
   /**
    * NOTE: We need `UpkOodleSqliteSize` prepended to the SQLite data,
    * and compress the file in chunks of up to `OODLE_MAX_BLOCK_SIZE`
    * and wrap the compressed chunk in `UpkOodle`
    */
   size_t new_size = data->size + sizeof (upk_sqlite_size);
-  byte *new_value = realloc(data->value, new_size);
-  if (new_value == NULL) {
-    printf_error("Reallocating memory of size %llu failed", new_size);
-    exit(EXIT_FAILURE);
-  }
-  memmove(new_value + sizeof(upk_sqlite_size), data->value, data->size);
+  ARENA_ALLOC_SIZE(arena, byte, new_value, new_size, ARENA_UNINITIALIZED);
   memcpy(new_value, &upk_sqlite_size, sizeof (upk_sqlite_size));
+  memcpy(new_value + sizeof (upk_sqlite_size), data->value, data->size);
   data->value = new_value;
   data->size = new_size;
 
+  /**
+   * Chunks are compressed straight into the result,
+   * so reserve the worst case for every chunk
+   */
+  size_t chunk_count = (data->size + OODLE_MAX_BLOCK_SIZE - 1) / OODLE_MAX_BLOCK_SIZE;
+  size_t chunk_bound = sizeof (UpkOodle) + (size_t) OodleLZ_Size_Needed(OodleLZ_Compressor_Kraken, OODLE_MAX_BLOCK_SIZE);
+  size_t result_size = 0;
+  ARENA_ALLOC_SIZE(arena, byte, result_data, chunk_count * chunk_bound, ARENA_UNINITIALIZED);
+
   UpkOodle upk;
   memset(&upk, 0, sizeof (upk));
   upk.signature = OODLE_COMPRESSED_BLOCK_SIGNATURE;
   upk.max_block_size = OODLE_MAX_BLOCK_SIZE;
 
-  OodleLZ_CompressOptions *constoptions = OodleLZ_Compress_Options(OodleLZ_Compressor_Kraken, OodleLZ_CompressionLevel_Fast);
+  /**
+   * Jobify lets the encoder split a chunk into jobs on our pool,
+   * next to the chunk tasks themselves
+   */
+  OodleLZ_CompressOptions options = *OodleLZ_Compress_Options(OodleLZ_Compressor_Kraken, OodleLZ_CompressionLevel_Fast);
+  options.jobify = jobify;
+
+  ARENA_ALLOC_SIZE(arena, EncodeJob, jobs, sizeof (EncodeJob) * chunk_count, ARENA_ZEROED);
 
   byte *tmp_data_value = data->value;
   size_t chunk_size = OODLE_MAX_BLOCK_SIZE;
   uint16_t chunk_index = 1;
   uint32_t pos = 0;
+
+  /**
+   * Walk the previous compressed stream alongside,
+   * `reuse_raw` is the raw offset of the block at `reuse_pos`
+   */
+  size_t reuse_pos = 0;
+  size_t reuse_raw = 0;
+  uint16_t reused_count = 0;
+  uint16_t repeated_count = 0;
+  kraken_init();
   do {
     /**
      * NOTE: Loop control must be first
      * thing in the LOOP BODY
      */
-    pos += OODLE_MAX_BLOCK_SIZE;
+    chunk_size = OODLE_MAX_BLOCK_SIZE;
+    pos += chunk_size;
     printf_verbose(verbose, "Raw Block #%u:", chunk_index);
 
     /**
@@ -121,47 +279,139 @@ void compress(UProperty *property, bool verbose) {
       printf_verbose(verbose, " Shrinking chunk #%u from %lu bytes to %llu bytes", chunk_index, OODLE_MAX_BLOCK_SIZE, chunk_size);
     }
 
+    /**
+     * The game reads every block but the last as exactly `OODLE_MAX_BLOCK_SIZE`
+     * raw bytes, so only the final block may be shorter. SQLite page sizes divide
+     * it, hence every boundary after the first block sits `sizeof (upk_sqlite_size)`
+     * bytes before a page boundary and a changed page dirties at most two blocks.
+     */
+    bool final_chunk = pos >= data->size;
+    if (chunk_size == 0 || (!final_chunk && chunk_size != OODLE_MAX_BLOCK_SIZE) || chunk_index > chunk_count) {
+      printf_error("Chunk #%u of %llu bytes does not match the %lu byte block layout", chunk_index, chunk_size, OODLE_MAX_BLOCK_SIZE);
+      exit(EXIT_FAILURE);
+    }
+
     printf_verbose(verbose, " Scratch max size: %lu bytes", OODLE_MAX_BLOCK_SIZE);
     printf_verbose(verbose, " Uncompressed size: %llu bytes", chunk_size);
 
+    EncodeJob *job = &jobs[chunk_index - 1];
+    job->raw = tmp_data_value;
+    job->raw_size = chunk_size;
+    job->options = options;
+    job->options.jobifyUserPtr = &job->jobify;
+
+    if (reuse != NULL) {
+      size_t raw_offset = tmp_data_value - (byte *) data->value;
+      UpkOodle previous;
+      while (reuse_raw < raw_offset && reuse_pos + sizeof (previous) <= reuse->compressed.size) {
+        memcpy(&previous, reuse->compressed.address + reuse_pos, sizeof (previous));
+        reuse_pos += sizeof (previous) + previous.blocks[0].compressed_size;
+        reuse_raw += previous.blocks[0].uncompressed_size;
+      }
+
+      if (reuse_raw == raw_offset && reuse_pos + sizeof (previous) <= reuse->compressed.size) {
+        memcpy(&previous, reuse->compressed.address + reuse_pos, sizeof (previous));
+        size_t previous_size = sizeof (previous) + previous.blocks[0].compressed_size;
+
+        if (previous.signature == OODLE_COMPRESSED_BLOCK_SIGNATURE
+          && previous.blocks[0].uncompressed_size == chunk_size
+          && previous_size <= chunk_bound
+          && reuse_pos + previous_size <= reuse->compressed.size
+          && reuse_matches(reuse, raw_offset, tmp_data_value, chunk_size)
+        ) {
+          printf_verbose(verbose, " Unchanged, reusing %llu compressed bytes", previous.blocks[0].compressed_size);
+          job->reused = reuse->compressed.address + reuse_pos;
+          job->reused_size = previous_size;
+          reused_count++;
+
+          chunk_index++;
+          tmp_data_value += chunk_size;
+          continue;
+        }
+      }
+    }
+
+    /**
+     * Every chunk gets its own worst case slot,
+     * slots are packed once compressed
+     */
+    job->output = result_data + (chunk_index - 1) * chunk_bound + sizeof (upk);
+
+    /**
+     * Single byte runs (zeroed pages mostly) skip the encoder,
+     * their compressed form is known up front
+     */
+    byte repeated = 0;
+    if (kraken_repeat_scan(tmp_data_value, chunk_size, &repeated)) {
+      printf_verbose(verbose, " Byte 0x%02X repeated, using memset block", repeated);
+      job->compressed_size = (int) kraken_encode_memset(repeated, job->output);
+      repeated_count++;
+
+      chunk_index++;
+      tmp_data_value += chunk_size;
+      continue;
+    }
+
     uint64_t compressed_size_needed = (uint64_t) OodleLZ_Size_Needed(OodleLZ_Compressor_Kraken, chunk_size);
     printf_verbose(verbose, " Compressed size required: %llu bytes", compressed_size_needed);
 
-    SAFE_ALLOC_SIZE(uint8_t, buffer, sizeof (uint8_t) * chunk_size);
-    memcpy(buffer, tmp_data_value, chunk_size);
+    job->task = pool_submit(encode_task, job);
+
+    chunk_index++;
+    tmp_data_value += chunk_size;
+  } while (pos < data->size);
+
+  /**
+   * Packing chunk N only writes below slot N + 1,
+   * so it is safe while later chunks are still compressing
+   */
+  for (size_t i = 0; i < (size_t) chunk_index - 1; i++) {
+    EncodeJob *job = &jobs[i];
 
-    SAFE_ALLOC_SIZE(uint8_t, output, sizeof (uint8_t) * compressed_size_needed);
+    if (job->reused != NULL) {
+      memcpy(result_data + result_size, job->reused, job->reused_size);
+      result_size += job->reused_size;
+      continue;
+    }
 
-    int compressed_bytes = OodleLZ_Compress(OodleLZ_Compressor_Kraken, buffer, chunk_size, output,
-      OodleLZ_CompressionLevel_Fast, constoptions, NULL, NULL, NULL, 0
-    );
-    printf_verbose(verbose, " Compressed size: %lu bytes", compressed_bytes);
+    if (job->task != NULL) {
+      pool_wait(job->task);
+    }
+    printf_verbose(verbose, "Raw Block #%llu compressed size: %d bytes", i + 1, job->compressed_size);
+
+    if (job->compressed_size <= 0) {
+      printf_error("Compressing chunk #%llu of %llu bytes failed", i + 1, job->raw_size);
+      exit(EXIT_FAILURE);
+    }
 
     /**
      * Wrap the compressed segment into `UpkOodle`
      */
-    upk.blocks[0].compressed_size = compressed_bytes;
-    upk.blocks[1].compressed_size = compressed_bytes;
-    upk.blocks[0].uncompressed_size = chunk_size;
-    upk.blocks[1].uncompressed_size = chunk_size;
+    upk.blocks[0].compressed_size = job->compressed_size;
+    upk.blocks[1].compressed_size = job->compressed_size;
+    upk.blocks[0].uncompressed_size = job->raw_size;
+    upk.blocks[1].uncompressed_size = job->raw_size;
 
     memcpy(result_data + result_size, &upk, sizeof (upk));
     result_size += sizeof (upk);
-    memcpy(result_data + result_size, output, compressed_bytes);
-    result_size += compressed_bytes;
-
-    free(buffer);
-    free(output);
+    memmove(result_data + result_size, job->output, job->compressed_size);
+    result_size += job->compressed_size;
+  }
 
-    chunk_index++;
-    tmp_data_value += chunk_size;
-  } while (pos < data->size);
+  LONG jobify_jobs = 0;
+  for (size_t i = 0; i < (size_t) chunk_index - 1; i++) {
+    jobify_jobs += jobs[i].jobify.jobs;
+  }
+  printf_verbose(verbose, "Encoder ran %ld jobs on %u worker thread(s)", jobify_jobs, pool_size());
+  printf_verbose(verbose, "Filled %u of %u blocks with a repeated byte", repeated_count, chunk_index - 1);
+  if (reuse != NULL) {
+    printf_verbose(verbose, "Reused %u of %u compressed blocks", reused_count, chunk_index - 1);
+  }
 
   /**
    * NOTE: UArrayProperty has + `UPROPERTY_ADDED_LENGTH`
    * bytes added to its length (pointer to embedded TYPE property??)
    */
-  free(data->value);
   data->size = result_size;
   data->value = result_data;
   property->length = data->size + UARRAYPROPERTY_ADDED_LENGTH;
@@ -169,35 +419,128 @@ void compress(UProperty *property, bool verbose) {
   releaseOodleLibrary();
 }
 
-void decompress(UProperty *property, bool verbose) {
+/**
+ * Decode block on the calling thread, `phase` selects which part of
+ * Kraken decoding to run; phase 1 (entropy) and phase 2 (match copy)
+ * have to share the job decoder memory
+ */
+static int decode_block(DecodeJob *job, OodleLZ_Decode_ThreadPhase phase) {
+  return OodleLZ_Decompress(
+    job->compressed, job->compressed_size,
+    job->output, job->uncompressed_size,
+    OodleLZ_FuzzSafe_No, OodleLZ_CheckCRC_No, OodleLZ_Verbosity_None,
+    NULL, 0, NULL, NULL, job->scratch, job->scratch_size,
+    phase
+  );
+}
+
+static void decode_phase1_task(void *argument) {
+  DecodeJob *job = (DecodeJob *) argument;
+  job->phase1_result = decode_block(job, OodleLZ_Decode_ThreadPhase1);
+}
+
+static bool decoded_fully(const DecodeJob *job, int decompressed_bytes) {
+  return decompressed_bytes > 0 && (size_t) decompressed_bytes == job->uncompressed_size;
+}
+
+/**
+ * Two phase decode scheduler:
+ * phase 1 of block N+1 runs on the pool while phase 2 of block N
+ * runs here. Once a block can not be phased (phase 1 fails or phase 2
+ * comes up short) it is decoded in one go and so is the rest of the stream,
+ * otherwise every block would be decoded twice.
+ */
+static void decode_blocks(DecodeJob *jobs, size_t count, bool verbose) {
+  bool pipelined = count > 1 && jobs[0].scratch != NULL && pool_size() > 0;
+  printf_verbose(verbose, "Decoding %zu blocks %s", count, pipelined ? "with two phase pipeline" : "in a single phase");
+
+  PoolTask *phase1 = pipelined ? pool_submit(decode_phase1_task, &jobs[0]) : NULL;
+  for (size_t i = 0; i < count; i++) {
+    DecodeJob *job = &jobs[i];
+
+    int decompressed_bytes = 0;
+    if (pipelined) {
+      pool_wait(phase1);
+      phase1 = i + 1 < count ? pool_submit(decode_phase1_task, &jobs[i + 1]) : NULL;
+
+      if (job->phase1_result > 0) {
+        decompressed_bytes = decode_block(job, OodleLZ_Decode_ThreadPhase2);
+      }
+
+      if (!decoded_fully(job, decompressed_bytes)) {
+        printf_verbose(verbose, " Block #%zu can not be decoded in two phases (phase 1 returned %d, phase 2 returned %d), decoding the rest of the stream in a single phase",
+          i, job->phase1_result, decompressed_bytes
+        );
+
+        /**
+         * Block N+1 phase 1 uses the other scratch slot, let it finish and drop it
+         */
+        pipelined = false;
+        if (phase1 != NULL) {
+          pool_wait(phase1);
+          phase1 = NULL;
+        }
+        decompressed_bytes = decode_block(job, OodleLZ_Decode_ThreadPhaseAll);
+      }
+    } else {
+      decompressed_bytes = decode_block(job, OodleLZ_Decode_ThreadPhaseAll);
+    }
+
+    printf_verbose(verbose, " Block #%zu decompressed: %d bytes", i, decompressed_bytes);
+    if (!decoded_fully(job, decompressed_bytes)) {
+      printf_error("Compressed block partial decompression detected! expected %zu bytes; decompressed %d bytes", job->uncompressed_size, decompressed_bytes);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+void decompress(UProperty *property, Arena *arena, bool verbose) {
   UArrayProperty *data = (UArrayProperty *) property->data;
 
   printf_verbose(verbose, "Decompressing %lu bytes of data...", data->size);
-  InitOodleLibrary();
 
   /**
-   * Do not even bother with realloc... just malloc big enough
-   * chunk of memory and forget...
-   *
-   * TODO: Refactor memory allocation strategy!
+   * Walk block headers first to size the result exactly,
+   * blocks are then decompressed straight into it
    */
+  size_t result_capacity = 0;
+  size_t block_count = 0;
+  UpkOodle upk;
+  for (size_t offset = 0; offset + sizeof (upk) <= data->size; offset += sizeof (upk) + upk.blocks[0].compressed_size) {
+    memcpy(&upk, (byte *) data->value + offset, sizeof (upk));
+    if (upk.signature != OODLE_COMPRESSED_BLOCK_SIGNATURE || upk.blocks[0].uncompressed_size > upk.max_block_size
+      || upk.blocks[0].compressed_size > data->size - offset - sizeof (upk)
+    ) {
+      break;
+    }
+    result_capacity += upk.blocks[0].uncompressed_size;
+    block_count++;
+  }
+  printf_verbose(verbose, "Decompressed size: %llu bytes", result_capacity);
+
   size_t result_size = 0;
-  SAFE_ALLOC_SIZE(byte, result_data, sizeof (byte) * property->length * OODLE_COMPRESSION_FACTOR_MAGIC);
+  ARENA_ALLOC_SIZE(arena, byte, result_data, result_capacity, ARENA_UNINITIALIZED);
+  ARENA_ALLOC_SIZE(arena, DecodeJob, jobs, sizeof (DecodeJob) * block_count, ARENA_ZEROED);
 
-  UpkOodle upk;
-  uint32_t pos = 0;
+  size_t job_count = 0;
+  size_t pos = 0;
   do {
+    if (sizeof (upk) > data->size - pos) {
+      printf_error("Compressed block header at position %llu is truncated", pos);
+      exit(EXIT_FAILURE);
+    }
+
     memset(&upk, 0, sizeof (upk));
     memcpy(&upk, (byte *) data->value + pos, sizeof (upk));
 
     if (memcmp(&upk.signature, signature, signature_len) != 0) {
-      printf_error("Compressed block at position %lu and signature %08X does not match %08X",
+      printf_error("Compressed block at position %llu and signature %08X does not match %08X",
         pos, _byteswap_ulong(upk.signature), _byteswap_ulong(OODLE_COMPRESSED_BLOCK_SIGNATURE)
       );
       exit(EXIT_FAILURE);
     }
 
-    printf_verbose(verbose, "Compressed Block #%lu:", pos);
+    printf_verbose(verbose, "Compressed Block #%llu:", pos);
     printf_verbose(verbose, " Signature: 0x%08X",_byteswap_ulong(upk.signature));
     printf_verbose(verbose, " Scratch max size: %llu bytes", upk.max_block_size);
     printf_verbose(verbose, " Compressed size: %llu bytes", upk.blocks[0].compressed_size);
@@ -206,34 +549,74 @@ void decompress(UProperty *property, bool verbose) {
     pos += sizeof (upk);
 
     uint64_t compressed_size = upk.blocks[0].compressed_size;
-    SAFE_ALLOC_SIZE(byte, buffer, sizeof (byte) * compressed_size);
-    memcpy(buffer, (byte *) data->value + pos, compressed_size);
+    if (compressed_size > data->size - pos) {
+      printf_error("Compressed block of %llu bytes is truncated at %lu bytes", compressed_size, data->size);
+      exit(EXIT_FAILURE);
+    }
+
+    byte *buffer = (byte *) data->value + pos;
     pos += compressed_size;
 
     uint64_t uncompressed_size = upk.blocks[0].uncompressed_size;
-    SAFE_ALLOC_SIZE(byte, output, sizeof (byte) * uncompressed_size);
-
-    int decompressed_bytes = OodleLZ_Decompress(
-      buffer, compressed_size,
-      output, uncompressed_size,
-      OodleLZ_FuzzSafe_No, OodleLZ_CheckCRC_No, OodleLZ_Verbosity_None,
-      NULL, 0, NULL, NULL, NULL, 0,
-      OodleLZ_Decode_ThreadPhaseAll
-    );
-
-    printf_verbose(verbose, " Decompressed: %d bytes", decompressed_bytes);
-    if (decompressed_bytes != uncompressed_size) {
-      printf_error("Compressed block partial decompression detected! expected %llu bytes; decompressed %lu bytes", uncompressed_size, decompressed_bytes);
+    if (job_count == block_count || result_size + uncompressed_size > result_capacity) {
+      printf_error("Compressed block uncompressed size %llu exceeds max block size %llu", uncompressed_size, upk.max_block_size);
       exit(EXIT_FAILURE);
     }
 
-    memcpy(result_data + result_size, output, decompressed_bytes);
-    result_size += decompressed_bytes;
+    DecodeJob *job = &jobs[job_count];
+    job->compressed = buffer;
+    job->compressed_size = compressed_size;
+    job->output = result_data + result_size;
+    job->uncompressed_size = uncompressed_size;
+    job_count++;
 
-    free(buffer);
-    free(output);
+    result_size += uncompressed_size;
   } while (pos < data->size);
 
+  /**
+   * Blocks in one of the known memset forms are filled right away,
+   * the rest is decoded with Oodle
+   */
+  kraken_init();
+  ARENA_ALLOC_SIZE(arena, DecodeJob, pending, sizeof (DecodeJob) * job_count, ARENA_ZEROED);
+  size_t pending_count = 0;
+  for (size_t i = 0; i < job_count; i++) {
+    byte repeated = 0;
+    if (kraken_memset_form(jobs[i].compressed, jobs[i].compressed_size, jobs[i].uncompressed_size, &repeated)) {
+      printf_verbose(verbose, " Block #%llu filled with byte 0x%02X", i, repeated);
+      kraken_fill(jobs[i].output, repeated, jobs[i].uncompressed_size);
+      continue;
+    }
+    pending[pending_count++] = jobs[i];
+  }
+  printf_verbose(verbose, "Blocks filled: %llu, decoded with Oodle: %llu", job_count - pending_count, pending_count);
+
+  if (pending_count > 0) {
+    InitOodleLibrary();
+
+    /**
+     * Decoder memory is carried from phase 1 to phase 2 of a block,
+     * one slot per block in flight, sized for both phased and whole block decodes
+     */
+    byte *scratch[DECODE_SCRATCH_SLOTS] = { NULL };
+    intptr_t scratch_size = OodleLZDecoder_Memory_Needed(OodleLZ_Compressor_Kraken, OODLE_MAX_BLOCK_SIZE);
+    intptr_t phased_size = OodleLZ_Phased_Memory_Needed();
+    scratch_size = phased_size > scratch_size ? phased_size : scratch_size;
+    if (scratch_size > 0) {
+      for (size_t slot = 0; slot < DECODE_SCRATCH_SLOTS; slot++) {
+        scratch[slot] = arena_alloc(arena, scratch_size, ARENA_UNINITIALIZED);
+      }
+    }
+    printf_verbose(verbose, "Decoder memory: %lld bytes per block", (int64_t) scratch_size);
+
+    for (size_t i = 0; i < pending_count; i++) {
+      pending[i].scratch = scratch[i % DECODE_SCRATCH_SLOTS];
+      pending[i].scratch_size = pending[i].scratch != NULL ? scratch_size : 0;
+    }
+
+    decode_blocks(pending, pending_count, verbose);
+  }
+
   /**
    * NOTE: Decompressed sqlite file has a header that specifies the size
    * of the sqlite data (aligned on pages)
@@ -264,17 +647,17 @@ void decompress(UProperty *property, bool verbose) {
 
   result_data = tmp_result_data;
 
-  SAFE_ALLOC_SIZE(byte, sqlite_data, sqlite_size);
-  memcpy(sqlite_data, result_data + sizeof (upk_sqlite_size), sqlite_size);
+  if (sizeof (upk_sqlite_size) + sqlite_size > result_size) {
+    printf_error("Expected sqlite database size (%lu) exceeds decompressed size (%llu)", sqlite_size, result_size);
+    exit(EXIT_FAILURE);
+  }
 
   /**
    * NOTE: UArrayProperty has + `UPROPERTY_ADDED_LENGTH`
    * bytes added to its length (pointer to embedded TYPE property??)
    */
-  free(result_data);
-  free(data->value);
   data->size = sqlite_size;
-  data->value = sqlite_data;
+  data->value = result_data + sizeof (upk_sqlite_size);
   property->length = data->size + UARRAYPROPERTY_ADDED_LENGTH;
 
   releaseOodleLibrary();
@@ -0,0 +1,318 @@
+#include "pool.h"
+
+/**
+ * Upper bound of worker threads, anything above
+ * is just contention on the deque locks
+ */
+#define POOL_MAX_THREADS 64
+
+typedef struct _POOL_DEQUE {
+  SRWLOCK lock;
+  PoolTask *head; // oldest, stolen from
+  PoolTask *tail; // newest, popped by the owner
+} PoolDeque;
+
+/**
+ * Deque at index `size` is the injection queue
+ * for tasks submitted from outside of the pool
+ */
+static struct {
+  SRWLOCK lock;
+  CONDITION_VARIABLE signal;
+  volatile LONG pending;
+  volatile LONG generation;
+  bool stop;
+  uint32_t size;
+  HANDLE threads[POOL_MAX_THREADS];
+  PoolDeque deques[POOL_MAX_THREADS + 1];
+} Pool = { SRWLOCK_INIT, CONDITION_VARIABLE_INIT, 0, 0, false, 0, { NULL }, { { SRWLOCK_INIT, NULL, NULL } } };
+
+static __declspec(thread) int32_t Pool_Worker_Index = -1;
+
+static void deque_push(PoolDeque *deque, PoolTask *task) {
+  AcquireSRWLockExclusive(&deque->lock);
+  task->next = NULL;
+  task->prev = deque->tail;
+  if (deque->tail != NULL) {
+    deque->tail->next = task;
+  } else {
+    deque->head = task;
+  }
+  deque->tail = task;
+  ReleaseSRWLockExclusive(&deque->lock);
+}
+
+/**
+ * Pop newest (owner) or oldest (thief) task,
+ * belonging to `group` unless it is NULL
+ */
+static PoolTask *deque_pop(PoolDeque *deque, bool newest, const void *group) {
+  AcquireSRWLockExclusive(&deque->lock);
+  PoolTask *task = newest ? deque->tail : deque->head;
+  while (task != NULL && group != NULL && task->group != group) {
+    task = newest ? task->prev : task->next;
+  }
+
+  if (task != NULL) {
+    if (task->prev != NULL) {
+      task->prev->next = task->next;
+    } else {
+      deque->head = task->next;
+    }
+
+    if (task->next != NULL) {
+      task->next->prev = task->prev;
+    } else {
+      deque->tail = task->prev;
+    }
+
+    task->prev = NULL;
+    task->next = NULL;
+  }
+  ReleaseSRWLockExclusive(&deque->lock);
+
+  return task;
+}
+
+/**
+ * Own deque first, then the injection queue, then steal
+ */
+static PoolTask *pool_take(const void *group) {
+  if (Pool.pending == 0) {
+    return NULL;
+  }
+
+  int32_t self = Pool_Worker_Index;
+  PoolTask *task = self >= 0 ? deque_pop(&Pool.deques[self], true, group) : NULL;
+
+  if (task == NULL) {
+    task = deque_pop(&Pool.deques[Pool.size], false, group);
+  }
+
+  for (uint32_t i = 1; task == NULL && i <= Pool.size; i++) {
+    uint32_t victim = (uint32_t) (self + i) % Pool.size;
+    task = deque_pop(&Pool.deques[victim], false, group);
+  }
+
+  if (task != NULL) {
+    InterlockedDecrement(&Pool.pending);
+  }
+
+  return task;
+}
+
+/**
+ * Queue a task whose dependencies are done, on the own deque of a worker
+ */
+static void pool_enqueue(PoolTask *task) {
+  int32_t self = Pool_Worker_Index;
+  InterlockedIncrement(&Pool.pending);
+  deque_push(&Pool.deques[self >= 0 ? (uint32_t) self : Pool.size], task);
+
+  AcquireSRWLockExclusive(&Pool.lock);
+  Pool.generation++;
+  WakeAllConditionVariable(&Pool.signal);
+  ReleaseSRWLockExclusive(&Pool.lock);
+}
+
+static void pool_unreference(PoolTask *task) {
+  if (InterlockedDecrement(&task->references) == 0) {
+    free(task);
+  }
+}
+
+/**
+ * Run the task, wake up everyone waiting for it
+ * and queue dependents it was the last dependency of, lock must NOT be held
+ */
+static void pool_run(PoolTask *task) {
+  task->function(task->argument);
+
+  /**
+   * Dependents are taken under the lock, once `done` is published
+   * the task may be released by its waiter
+   */
+  AcquireSRWLockExclusive(&Pool.lock);
+  PoolLink *dependents = task->dependents;
+  task->dependents = NULL;
+  InterlockedExchange(&task->done, 1);
+  Pool.generation++;
+  WakeAllConditionVariable(&Pool.signal);
+  ReleaseSRWLockExclusive(&Pool.lock);
+
+  while (dependents != NULL) {
+    PoolLink *link = dependents;
+    dependents = link->next;
+    if (InterlockedDecrement(&link->task->blockers) == 0) {
+      pool_enqueue(link->task);
+    }
+    free(link);
+  }
+}
+
+static DWORD WINAPI pool_worker(LPVOID parameter) {
+  Pool_Worker_Index = (int32_t) (intptr_t) parameter;
+
+  while (true) {
+    PoolTask *task = pool_take(NULL);
+    if (task != NULL) {
+      pool_run(task);
+      continue;
+    }
+
+    AcquireSRWLockExclusive(&Pool.lock);
+    if (Pool.stop && Pool.pending == 0) {
+      ReleaseSRWLockExclusive(&Pool.lock);
+      break;
+    }
+
+    if (Pool.pending == 0) {
+      SleepConditionVariableSRW(&Pool.signal, &Pool.lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&Pool.lock);
+  }
+
+  return 0;
+}
+
+/**
+ * Spawn worker threads, zero means one per logical processor
+ */
+void pool_init(uint32_t threads) {
+  if (Pool.size > 0) {
+    return;
+  }
+
+  if (threads == 0) {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    threads = system_info.dwNumberOfProcessors;
+  }
+
+  if (threads > POOL_MAX_THREADS) {
+    threads = POOL_MAX_THREADS;
+  }
+
+  for (uint32_t i = 0; i <= threads; i++) {
+    InitializeSRWLock(&Pool.deques[i].lock);
+    Pool.deques[i].head = NULL;
+    Pool.deques[i].tail = NULL;
+  }
+
+  /**
+   * Workers index deques by pool size, publish it before they start
+   */
+  Pool.stop = false;
+  Pool.size = threads;
+  for (uint32_t i = 0; i < threads; i++) {
+    Pool.threads[i] = CreateThread(NULL, 0, pool_worker, (LPVOID) (intptr_t) i, 0, NULL);
+    if (Pool.threads[i] == NULL) {
+      printf_error("CreateThread(); failed to spawn pool worker #%u with error code %lu", i, GetLastError());
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/**
+ * Let the workers drain the deques and join them
+ */
+void pool_release() {
+  AcquireSRWLockExclusive(&Pool.lock);
+  Pool.stop = true;
+  WakeAllConditionVariable(&Pool.signal);
+  ReleaseSRWLockExclusive(&Pool.lock);
+
+  for (uint32_t i = 0; i < Pool.size; i++) {
+    WaitForSingleObject(Pool.threads[i], INFINITE);
+    CloseHandle(Pool.threads[i]);
+    Pool.threads[i] = NULL;
+  }
+
+  Pool.size = 0;
+}
+
+uint32_t pool_size() {
+  return Pool.size;
+}
+
+/**
+ * Queue a task, the returned handle has to be passed to `pool_wait()`
+ */
+PoolTask *pool_submit(PoolTask_FP *function, void *argument) {
+  return pool_submit_after(function, argument, NULL, NULL, 0);
+}
+
+/**
+ * Queue a task of `group` once every dependency is done,
+ * dependencies have to stay valid (not waited for) until this returns
+ */
+PoolTask *pool_submit_after(PoolTask_FP *function, void *argument, const void *group, PoolTask **dependencies, int count) {
+  SAFE_ALLOC(PoolTask, task);
+  task->function = function;
+  task->argument = argument;
+  task->group = group;
+  task->references = 1;
+  task->blockers = 1;
+
+  for (int i = 0; i < count; i++) {
+    SAFE_ALLOC(PoolLink, link);
+    link->task = task;
+
+    AcquireSRWLockExclusive(&Pool.lock);
+    bool pending = !dependencies[i]->done;
+    if (pending) {
+      link->next = dependencies[i]->dependents;
+      dependencies[i]->dependents = link;
+      InterlockedIncrement(&task->blockers);
+    }
+    ReleaseSRWLockExclusive(&Pool.lock);
+
+    if (!pending) {
+      free(link);
+    }
+  }
+
+  /**
+   * Drop the submit blocker, the last dependency to finish queues it otherwise
+   */
+  if (InterlockedDecrement(&task->blockers) == 0) {
+    pool_enqueue(task);
+  }
+
+  return task;
+}
+
+/**
+ * Wait for the task to finish while helping with any queued task,
+ * then drop the reference to the task handle
+ */
+void pool_wait(PoolTask *task) {
+  pool_wait_group(task, NULL);
+}
+
+/**
+ * Wait for the task to finish while helping with queued tasks
+ * of `group` only (any task if NULL), then drop the reference
+ */
+void pool_wait_group(PoolTask *task, const void *group) {
+  while (!task->done) {
+    LONG generation = Pool.generation;
+    PoolTask *queued = pool_take(group);
+    if (queued != NULL) {
+      pool_run(queued);
+      continue;
+    }
+
+    /**
+     * Every submit and completion bumps the generation under the lock,
+     * so nothing queued since the scan above can be missed
+     */
+    AcquireSRWLockExclusive(&Pool.lock);
+    if (!task->done && Pool.generation == generation) {
+      SleepConditionVariableSRW(&Pool.signal, &Pool.lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&Pool.lock);
+  }
+
+  pool_unreference(task);
+}